@@ -3,11 +3,37 @@
 #include <cassert>
 #include <cstring>
 #include <iostream> // testing
+#include <thread>
 using namespace std;
 
+// number of failed attempts on the ring before a thread parks
+#define RING_SPINS 64
 
-BoundedBuffer::BoundedBuffer (int _cap) : cap(_cap) {
-    // modify as needed
+
+BoundedBuffer::BoundedBuffer (int _cap, Backend _backend, int _slotsize) : cap(_cap), backend(_backend), mask(0),
+    enqueuePos(0), dequeuePos(0), pushWaiters(0), popWaiters(0), slotSize(_slotsize), readyHead(0), readyCount(0) {
+    if (backend == RING_BACKEND) {
+        // round capacity up to a power of two; one slot would make full and empty indistinguishable
+        size_t slots = 2;
+        while (slots < static_cast<size_t>(cap)) {
+            slots <<= 1;
+        }
+        mask = slots - 1;
+        ring.reset(new Slot[slots]);
+        for (size_t i = 0; i < slots; i++) {
+            ring[i].seq.store(i, memory_order_relaxed);
+        }
+    }
+    else if (backend == POOL_BACKEND) {
+        assert(cap > 0 && slotSize > 0);
+        arena.resize(static_cast<size_t>(cap) * slotSize);
+        slotLength.resize(cap, 0);
+        readySlots.resize(cap, 0);
+        freeSlots.reserve(cap);
+        for (int i = cap - 1; i >= 0; i--) {
+            freeSlots.push_back(i);
+        }
+    }
 }
 
 BoundedBuffer::~BoundedBuffer () {
@@ -15,6 +41,20 @@ BoundedBuffer::~BoundedBuffer () {
 }
 
 void BoundedBuffer::push (char* msg, int size) {
+    if (backend == RING_BACKEND) {
+        ring_blocking_push(msg, size);
+        ring_wake(popWaiters, popCondition, false);
+        return;
+    }
+    else if (backend == POOL_BACKEND) {
+        char* slot;
+        int handle = reserve(&slot);
+        size = min(size, slotSize);
+        memcpy(slot, msg, size);
+        commit(handle, size);
+        return;
+    }
+
     // 1. Convert the incoming byte sequence given by msg and size into a vector<char>
     //      use one of the vector constructor's
     vector<char> data(msg, msg + size);
@@ -23,7 +63,7 @@ void BoundedBuffer::push (char* msg, int size) {
     unique_lock<mutex> lock(bufferMutex);
     pushCondition.wait(lock, [this] {return q.size() < static_cast<size_t>(cap);});
     // 3. Then push the vector at the end of the queue
-    q.push(data);
+    q.push(move(data));
     // 4. Wake up threads that were waiting for push
     //      notifying data available
     lock.unlock();
@@ -32,12 +72,27 @@ void BoundedBuffer::push (char* msg, int size) {
 }
 
 int BoundedBuffer::pop(char* msg, int size) {
+    if (backend == RING_BACKEND) {
+        int data_size = ring_blocking_pop(msg, size);
+        ring_wake(pushWaiters, pushCondition, false);
+        return data_size;
+    }
+    else if (backend == POOL_BACKEND) {
+        char* slot;
+        int data_size;
+        int handle = acquire(&slot, &data_size);
+        data_size = min(data_size, size);
+        memcpy(msg, slot, data_size);
+        release(handle);
+        return data_size;
+    }
+
     // 1. Wait until the queue has at least 1 item
     std::unique_lock<std::mutex> lock(bufferMutex);
     popCondition.wait(lock, [this] { return !q.empty(); });
     
     // 2. Pop the front item of the queue. The popped item is a vector<char>
-    std::vector<char> data = q.front();
+    std::vector<char> data = move(q.front());
     q.pop();
     
     // 3. Convert the popped vector<char> into a char*, copy that into msg
@@ -62,5 +117,311 @@ int BoundedBuffer::pop(char* msg, int size) {
 
 
 size_t BoundedBuffer::size () {
+    if (backend == RING_BACKEND) {
+        size_t tail = dequeuePos.load(memory_order_acquire);
+        size_t head = enqueuePos.load(memory_order_acquire);
+        return head > tail ? head - tail : 0;
+    }
+    lock_guard<mutex> lock(bufferMutex);
+    if (backend == POOL_BACKEND) {
+        return readyCount;
+    }
     return q.size();
 }
+
+int BoundedBuffer::reserve (char** slot) {
+    assert(backend == POOL_BACKEND);
+    unique_lock<mutex> lock(bufferMutex);
+    pushCondition.wait(lock, [this] { return !freeSlots.empty(); });
+    int handle = freeSlots.back();
+    freeSlots.pop_back();
+    lock.unlock();
+
+    *slot = &arena[static_cast<size_t>(handle) * slotSize];
+    return handle;
+}
+
+void BoundedBuffer::commit (int handle, int size) {
+    assert(size <= slotSize);
+    unique_lock<mutex> lock(bufferMutex);
+    slotLength[handle] = size;
+    readySlots[(readyHead + readyCount) % cap] = handle;
+    readyCount++;
+    lock.unlock();
+    popCondition.notify_one(); // notifying data available
+}
+
+int BoundedBuffer::acquire (char** slot, int* size) {
+    assert(backend == POOL_BACKEND);
+    unique_lock<mutex> lock(bufferMutex);
+    popCondition.wait(lock, [this] { return readyCount > 0; });
+    int handle = readySlots[readyHead];
+    readyHead = (readyHead + 1) % cap;
+    readyCount--;
+    *size = slotLength[handle];
+    lock.unlock();
+
+    *slot = &arena[static_cast<size_t>(handle) * slotSize];
+    return handle;
+}
+
+void BoundedBuffer::release (int handle) {
+    unique_lock<mutex> lock(bufferMutex);
+    freeSlots.push_back(handle);
+    lock.unlock();
+    pushCondition.notify_one(); // notifying slot available
+}
+
+int BoundedBuffer::slot_size () {
+    return slotSize;
+}
+
+bool BoundedBuffer::ring_try_push (char* msg, int size) {
+    size_t pos = enqueuePos.load(memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &ring[pos & mask];
+        size_t seq = slot->seq.load(memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            // slot is free for this position, but the ring may have more slots than cap
+            if ((intptr_t) (pos - dequeuePos.load(memory_order_acquire)) >= cap) {
+                return false;
+            }
+            // claim it
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // slot still holds the item from one lap ago, ring is full
+            return false;
+        }
+        else {
+            pos = enqueuePos.load(memory_order_relaxed);
+        }
+    }
+
+    slot->data.assign(msg, msg + size);
+    slot->seq.store(pos + 1, memory_order_release);
+    return true;
+}
+
+int BoundedBuffer::ring_try_pop (char* msg, int size) {
+    size_t pos = dequeuePos.load(memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &ring[pos & mask];
+        size_t seq = slot->seq.load(memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // producer has not published this position yet, ring is empty
+            return -1;
+        }
+        else {
+            pos = dequeuePos.load(memory_order_relaxed);
+        }
+    }
+
+    // same truncation rule as the queue backend
+    size_t data_size = min(slot->data.size(), static_cast<size_t>(size));
+    memcpy(msg, slot->data.data(), data_size);
+    slot->seq.store(pos + mask + 1, memory_order_release);
+    return static_cast<int>(data_size);
+}
+
+void BoundedBuffer::ring_blocking_push (char* msg, int size) {
+    for (int i = 0; i < RING_SPINS; i++) {
+        if (ring_try_push(msg, size)) {
+            return;
+        }
+        this_thread::yield();
+    }
+
+    // ring is full: park until a consumer frees a slot
+    unique_lock<mutex> lock(bufferMutex);
+    pushWaiters.fetch_add(1);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!ring_try_push(msg, size)) {
+        pushCondition.wait(lock);
+    }
+    pushWaiters.fetch_sub(1);
+}
+
+int BoundedBuffer::ring_blocking_pop (char* msg, int size) {
+    int data_size;
+    for (int i = 0; i < RING_SPINS; i++) {
+        if ((data_size = ring_try_pop(msg, size)) >= 0) {
+            return data_size;
+        }
+        this_thread::yield();
+    }
+
+    // ring is empty: park until a producer publishes an item
+    unique_lock<mutex> lock(bufferMutex);
+    popWaiters.fetch_add(1);
+    atomic_thread_fence(memory_order_seq_cst);
+    while ((data_size = ring_try_pop(msg, size)) < 0) {
+        popCondition.wait(lock);
+    }
+    popWaiters.fetch_sub(1);
+    return data_size;
+}
+
+void BoundedBuffer::ring_wake (atomic<int>& waiters, condition_variable& cond, bool all) {
+    // pairs with the fence a parking thread issues between registering and re-checking the ring
+    atomic_thread_fence(memory_order_seq_cst);
+    if (waiters.load(memory_order_relaxed) > 0) {
+        lock_guard<mutex> lock(bufferMutex);
+        if (all) {
+            cond.notify_all();
+        }
+        else {
+            cond.notify_one();
+        }
+    }
+}
+
+void BoundedBuffer::push_n (char* msgs, int stride, int* sizes, int n) {
+    if (n <= 0) {
+        return;
+    }
+
+    if (backend == RING_BACKEND) {
+        int pending = 0; // pushed but not yet announced to consumers
+        for (int i = 0; i < n; i++) {
+            char* msg = msgs + static_cast<size_t>(i) * stride;
+            if (!ring_try_push(msg, sizes[i])) {
+                // announce what is already in the ring before parking on a full one
+                if (pending > 0) {
+                    ring_wake(popWaiters, popCondition, pending > 1);
+                    pending = 0;
+                }
+                ring_blocking_push(msg, sizes[i]);
+            }
+            pending++;
+        }
+        ring_wake(popWaiters, popCondition, pending > 1);
+        return;
+    }
+
+    int i = 0;
+    int moved = 0;
+    unique_lock<mutex> lock(bufferMutex);
+    while (i < n) {
+        if (backend == POOL_BACKEND) {
+            pushCondition.wait(lock, [this] { return !freeSlots.empty(); });
+        }
+        else {
+            pushCondition.wait(lock, [this] { return q.size() < static_cast<size_t>(cap); });
+        }
+
+        moved = 0;
+        for (; i < n; i++, moved++) {
+            char* msg = msgs + static_cast<size_t>(i) * stride;
+            if (backend == POOL_BACKEND) {
+                if (freeSlots.empty()) {
+                    break;
+                }
+                int handle = freeSlots.back();
+                freeSlots.pop_back();
+                int size = min(sizes[i], slotSize);
+                memcpy(&arena[static_cast<size_t>(handle) * slotSize], msg, size);
+                slotLength[handle] = size;
+                readySlots[(readyHead + readyCount) % cap] = handle;
+                readyCount++;
+            }
+            else {
+                if (q.size() >= static_cast<size_t>(cap)) {
+                    break;
+                }
+                q.emplace(msg, msg + sizes[i]);
+            }
+        }
+
+        if (i < n) {
+            // buffer filled up mid-batch: let consumers drain it before waiting for room
+            popCondition.notify_all();
+        }
+    }
+    lock.unlock();
+
+    if (moved > 1) {
+        popCondition.notify_all();
+    }
+    else {
+        popCondition.notify_one();
+    }
+}
+
+int BoundedBuffer::pop_n (char* msgs, int stride, int* sizes, int n) {
+    return pop_batch(msgs, stride, sizes, n, true);
+}
+
+int BoundedBuffer::try_pop_n (char* msgs, int stride, int* sizes, int n) {
+    return pop_batch(msgs, stride, sizes, n, false);
+}
+
+int BoundedBuffer::pop_batch (char* msgs, int stride, int* sizes, int n, bool block) {
+    if (n <= 0) {
+        return 0;
+    }
+
+    int count = 0;
+    if (backend == RING_BACKEND) {
+        if (block) {
+            sizes[count++] = ring_blocking_pop(msgs, stride);
+        }
+        while (count < n) {
+            int data_size = ring_try_pop(msgs + static_cast<size_t>(count) * stride, stride);
+            if (data_size < 0) {
+                break;
+            }
+            sizes[count++] = data_size;
+        }
+        if (count > 0) {
+            ring_wake(pushWaiters, pushCondition, count > 1);
+        }
+        return count;
+    }
+
+    unique_lock<mutex> lock(bufferMutex);
+    if (backend == POOL_BACKEND) {
+        if (block) {
+            popCondition.wait(lock, [this] { return readyCount > 0; });
+        }
+        for (; count < n && readyCount > 0; count++) {
+            int handle = readySlots[readyHead];
+            readyHead = (readyHead + 1) % cap;
+            readyCount--;
+            sizes[count] = min(slotLength[handle], stride);
+            memcpy(msgs + static_cast<size_t>(count) * stride, &arena[static_cast<size_t>(handle) * slotSize], sizes[count]);
+            freeSlots.push_back(handle);
+        }
+    }
+    else {
+        if (block) {
+            popCondition.wait(lock, [this] { return !q.empty(); });
+        }
+        for (; count < n && !q.empty(); count++) {
+            vector<char>& data = q.front();
+            sizes[count] = min(static_cast<int>(data.size()), stride);
+            memcpy(msgs + static_cast<size_t>(count) * stride, data.data(), sizes[count]);
+            q.pop();
+        }
+    }
+    lock.unlock();
+
+    if (count > 1) {
+        pushCondition.notify_all();
+    }
+    else if (count == 1) {
+        pushCondition.notify_one();
+    }
+    return count;
+}
@@ -1,15 +1,28 @@
 #ifndef _BOUNDEDBUFFER_H_
 #define _BOUNDEDBUFFER_H_
 
+#include <atomic>
 #include <queue>
 #include <vector>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 
 class BoundedBuffer {
+public:
+	/* QUEUE_BACKEND keeps the original mutex-protected std::queue.
+	 * RING_BACKEND is a lock-free multi-producer/multi-consumer ring with one sequence
+	 * number per slot; threads only park on a condition variable when the ring is full or empty.
+	 * POOL_BACKEND preallocates cap fixed-size slots up front, so steady-state traffic does no
+	 * heap allocation; each message is copied once in and once out (or not at all through
+	 * reserve/commit and acquire/release).
+	 */
+	enum Backend {QUEUE_BACKEND, RING_BACKEND, POOL_BACKEND};
+
 private:
     // max number of items in the buffer
 	int cap;
+	Backend backend;
 
     /* The queue of items in the buffer
      * Note that each item a sequence of characters that is best represented by a vector<char> for 2 reasons:
@@ -19,21 +32,84 @@ private:
      */
 	std::queue<std::vector<char>> q;
 
-	// add necessary synchronization variables and data structures 
+	// add necessary synchronization variables and data structures
 	// mutex
 	// 2 cond var - one for data available, one for slot available
 	std::mutex bufferMutex;
 	std::condition_variable pushCondition; // Condition variable for data available
     std::condition_variable popCondition;
 
+	/* Ring backend (Vyukov-style bounded MPMC queue)
+	 * The ring has a power-of-two number of slots (cap rounded up, at least 2); producers never
+	 * claim a position more than cap ahead of the dequeue position, so it still holds at most cap
+	 * messages. A slot whose sequence equals the enqueue position is free for a producer; a slot
+	 * whose sequence equals position+1 holds data for a consumer. The slot vectors keep their
+	 * capacity once warmed up.
+	 */
+	struct Slot {
+		std::atomic<size_t> seq;
+		std::vector<char> data;
+	};
+	std::unique_ptr<Slot[]> ring;
+	size_t mask;
+
+	// producer and consumer positions live on separate cache lines
+	alignas(64) std::atomic<size_t> enqueuePos;
+	alignas(64) std::atomic<size_t> dequeuePos;
+
+	// number of threads parked on pushCondition/popCondition (ring backend only)
+	std::atomic<int> pushWaiters;
+	std::atomic<int> popWaiters;
+
+	/* Pool backend
+	 * All slots live in one contiguous arena of cap * slotSize bytes. freeSlots is a stack of
+	 * unused slot handles, readySlots a circular array of committed handles in FIFO order.
+	 * Both are sized once in the constructor and guarded by bufferMutex.
+	 */
+	int slotSize;
+	std::vector<char> arena;
+	std::vector<int> slotLength;
+	std::vector<int> freeSlots;
+	std::vector<int> readySlots;
+	int readyHead;
+	int readyCount;
+
+	bool ring_try_push (char* msg, int size);
+	int ring_try_pop (char* msg, int size);
+	void ring_blocking_push (char* msg, int size);
+	int ring_blocking_pop (char* msg, int size);
+	void ring_wake (std::atomic<int>& waiters, std::condition_variable& cond, bool all);
+	int pop_batch (char* msgs, int stride, int* sizes, int n, bool block);
 
 public:
-	BoundedBuffer (int _cap);
+	BoundedBuffer (int _cap, Backend _backend = QUEUE_BACKEND, int _slotsize = 256);
+	/* _slotsize is only used by POOL_BACKEND and is the largest message a slot can hold;
+	 longer messages are truncated to it. */
 	~BoundedBuffer ();
 
 	void push (char* msg, int size);
 	int pop (char* msg, int size);
 
+	/* Batched variants: message i lives at msgs + i*stride and is sizes[i] bytes long.
+	 push_n pushes all n messages, taking the lock (and waking consumers) once per run of
+	 messages that fits in the buffer. pop_n blocks for at least one message and then takes
+	 up to n that are already available, truncating each to stride bytes; it returns how
+	 many were popped. */
+	void push_n (char* msgs, int stride, int* sizes, int n);
+	int pop_n (char* msgs, int stride, int* sizes, int n);
+	int try_pop_n (char* msgs, int stride, int* sizes, int n);
+	/* Like pop_n, but returns 0 instead of blocking when the buffer is empty. */
+
+	/* Slot handoff for POOL_BACKEND. A producer reserves a free slot (blocking while the pool
+	 is exhausted), fills up to slot_size() bytes in place, then commits it with the message
+	 length. A consumer acquires the oldest committed slot, reads it in place and releases it
+	 back to the pool. Returned handles are only valid until commit/release. */
+	int reserve (char** slot);
+	void commit (int handle, int size);
+	int acquire (char** slot, int* size);
+	void release (int handle);
+	int slot_size ();
+
 	size_t size ();
 };
 
@@ -6,7 +6,7 @@ using namespace std;
 /*		CONSTRUCTOR/DESTRUCTOR FOR CLASS	R e q u e s t C h a n n e l		*/
 /*--------------------------------------------------------------------------*/
 
-FIFORequestChannel::FIFORequestChannel (const string _name, const Side _side) : my_name( _name), my_side(_side) {
+FIFORequestChannel::FIFORequestChannel (const string _name, const Side _side) : RequestChannel(_name, _side) {
 	pipe1 = "fifo_" + my_name + "1";
 	pipe2 = "fifo_" + my_name + "2";
 		
@@ -51,6 +51,23 @@ int FIFORequestChannel::cwrite (void* msgbuf, int msgsize) {
 	return write (wfd, msgbuf, msgsize);
 }
 
-string FIFORequestChannel::name () {
-	return my_name;
+int FIFORequestChannel::cwrite_file (int fd, __int64_t offset, int length, char* buf) {
+	loff_t off = offset;
+	int nbytes = 0;
+	while (nbytes < length) {
+		ssize_t r = splice(fd, &off, wfd, NULL, length - nbytes, SPLICE_F_MOVE);
+		if (r < 0 && nbytes == 0 && (errno == EINVAL || errno == ENOSYS)) {
+			// e.g. a file system without splice support; nothing has been written yet
+			return RequestChannel::cwrite_file(fd, offset, length, buf);
+		}
+		if (r <= 0) {
+			return nbytes > 0 ? nbytes : -1;
+		}
+		nbytes += r;
+	}
+	return nbytes;
+}
+
+int FIFORequestChannel::poll_fd () {
+	return rfd;
 }
@@ -1,19 +1,12 @@
 #ifndef _FIFORequestChannel_H_
 #define _FIFORequestChannel_H_
 
-#include "common.h"
+#include "RequestChannel.h"
 
 
-class FIFORequestChannel {
-public:
-	enum Side {SERVER_SIDE, CLIENT_SIDE};
-	enum Mode {READ_MODE, WRITE_MODE};
-	
+class FIFORequestChannel : public RequestChannel {
 private:
 	/*  The current implementation uses named pipes. */
-	std::string my_name;
-	Side my_side;
-	
 	int wfd;
 	int rfd;
 	
@@ -42,7 +35,7 @@ public:
 	 mechanisms associated with the channel. */
 
 
-	int cread (void* msgbuf, int msgsize);
+	int cread (void* msgbuf, int msgsize) override;
 	/* Blocking read of data from the channel. You must provide the address to properly allocated
 	memory buffer and its capacity as arguments. The 2nd argument is needed because the recepient 
 	side may not have as much capacity as the sender wants to send.
@@ -50,12 +43,17 @@ public:
 	In reply, the function puts the read data in the buffer and  
 	returns an integer that tells how much data is read. If the read fails, it returns -1. */
 	
-	int cwrite (void *msgbuf, int msgsize);
+	int cwrite (void *msgbuf, int msgsize) override;
 	/* Writes msglen bytes from the msgbuf to the channel. The function returns the actual number of 
 	bytes written and that can be less than msglen (even 0) probably due to buffer limitation (e.g., the recepient
 	cannot accept msglen bytes due to its own buffer capacity. */
-	 
-	std::string name (); 
+
+	int cwrite_file (int fd, __int64_t offset, int length, char* buf) override;
+	/* Splices the file bytes straight into the write end of the pipe, so they never pass
+	through user space. Falls back to the copying version if the file cannot be spliced. */
+
+	int poll_fd () override;
+	/* The read end of the pipe. */
 };
 
 #endif
@@ -0,0 +1,89 @@
+#include "FileCache.h"
+#include "common.h"
+
+using namespace std;
+
+
+FileCache::FileCache (int _capacity) : capacity(_capacity) {}
+
+FileCache::~FileCache () {
+	for (auto& e : entries) {
+		close(e.second->fd);
+		delete e.second;
+	}
+}
+
+FileCache::Entry* FileCache::acquire (const string& filename) {
+	lock_guard<mutex> lock(lck);
+	auto it = entries.find(filename);
+	if (it != entries.end()) {
+		Entry* entry = it->second;
+		struct stat buf;
+		if (stat(filename.c_str(), &buf) == 0 && buf.st_dev == entry->dev && buf.st_ino == entry->ino
+			&& (__int64_t) buf.st_size == entry->size && buf.st_mtim.tv_sec == entry->mtime.tv_sec
+			&& buf.st_mtim.tv_nsec == entry->mtime.tv_nsec) {
+			entry->refs++;
+			lru.splice(lru.begin(), lru, entry->lru_pos);
+			return entry;
+		}
+		// the file changed or is gone since it was opened
+		drop(entry);
+	}
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat buf;
+	if (fstat(fd, &buf) < 0) {
+		close(fd);
+		return nullptr;
+	}
+	Entry* entry = new Entry{filename, fd, (__int64_t) buf.st_size, buf.st_dev, buf.st_ino, buf.st_mtim, 1, false, lru.end()};
+	lru.push_front(entry);
+	entry->lru_pos = lru.begin();
+	entries[filename] = entry;
+	evict();
+	return entry;
+}
+
+void FileCache::release (Entry* entry) {
+	lock_guard<mutex> lock(lck);
+	entry->refs--;
+	if (entry->stale) {
+		if (entry->refs == 0) {
+			close(entry->fd);
+			delete entry;
+		}
+		return;
+	}
+	evict();
+}
+
+// takes entry out of the cache; it is closed now, or on its last release if someone holds it
+void FileCache::drop (Entry* entry) {
+	lru.erase(entry->lru_pos);
+	entries.erase(entry->filename);
+	if (entry->refs > 0) {
+		entry->stale = true;
+		return;
+	}
+	close(entry->fd);
+	delete entry;
+}
+
+// closes least recently used entries that nobody holds until the cache is back within capacity
+void FileCache::evict () {
+	auto it = lru.end();
+	while ((int) entries.size() > capacity && it != lru.begin()) {
+		--it;
+		Entry* entry = *it;
+		if (entry->refs > 0) {
+			continue;
+		}
+		it = lru.erase(it);
+		entries.erase(entry->filename);
+		close(entry->fd);
+		delete entry;
+	}
+}
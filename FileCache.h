@@ -0,0 +1,53 @@
+#ifndef _FILECACHE_H_
+#define _FILECACHE_H_
+
+#include <sys/stat.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+/* Server-wide cache of open files, keyed by file name. Each entry keeps a read-only fd
+ and the size it had when it was opened, so FILE_MSG chunks and size queries no longer
+ reopen the file. Entries are reference counted: a channel thread acquires an entry,
+ serves its chunk with the fd (pread/splice at an offset, which never moves a shared
+ file position) and releases it. At most capacity unreferenced entries stay open; the
+ least recently used ones are closed first.
+ A hit stats the name again, and an entry whose file was rewritten or replaced since it
+ was opened (other inode, size or mtime) is dropped and the file reopened; threads still
+ holding the old entry keep its fd until they release it. */
+class FileCache {
+public:
+	struct Entry {
+		std::string filename;
+		int fd;
+		__int64_t size;
+		dev_t dev;
+		ino_t ino;
+		struct timespec mtime;
+		int refs;
+		bool stale; // replaced by a newer entry, closed on its last release
+		std::list<Entry*>::iterator lru_pos;
+	};
+
+private:
+	int capacity;
+	std::unordered_map<std::string, Entry*> entries;
+	std::list<Entry*> lru; // most recently used first
+	std::mutex lck;
+
+	void evict ();
+	void drop (Entry* entry);
+
+public:
+	FileCache (int _capacity);
+	~FileCache ();
+
+	Entry* acquire (const std::string& filename);
+	/* Returns the entry for filename, opening the file if it is not cached, or nullptr if
+	 it cannot be opened. The entry stays valid until the matching release. */
+	void release (Entry* entry);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <math.h>
+#include "HdrHistogram.h"
+
+using namespace std;
+
+
+HdrHistogram::HdrHistogram (double _unit, double _highest, int _sigdigits) : unit(_unit) {
+	sigdigits = std::min(std::max(_sigdigits, 1), 5);
+	highest = std::max((int64_t) ceil(_highest / unit), (int64_t) 2);
+
+	// enough sub-buckets to tell 2 * 10^sigdigits units apart at full resolution
+	int64_t largest_single_unit = 2 * (int64_t) pow(10, sigdigits);
+	int magnitude = (int) ceil(log2((double) largest_single_unit));
+	sub_bucket_half_count_magnitude = std::max(magnitude, 1) - 1;
+	sub_bucket_count = 1 << (sub_bucket_half_count_magnitude + 1);
+	sub_bucket_half_count = sub_bucket_count / 2;
+	sub_bucket_mask = sub_bucket_count - 1;
+
+	// each further bucket doubles the range covered
+	int64_t smallest_untrackable = sub_bucket_count;
+	bucket_count = 1;
+	while (smallest_untrackable <= highest) {
+		smallest_untrackable <<= 1;
+		bucket_count++;
+	}
+
+	zero_index = (bucket_count + 1) * sub_bucket_half_count;
+	counts = vector<int64_t>(2 * zero_index, 0);
+	clear();
+}
+
+int HdrHistogram::index_of (int64_t magnitude) {
+	int bucket = 64 - __builtin_clzll(magnitude | sub_bucket_mask) - (sub_bucket_half_count_magnitude + 1);
+	int sub_bucket = (int) (magnitude >> bucket);
+	return ((bucket + 1) << sub_bucket_half_count_magnitude) + (sub_bucket - sub_bucket_half_count);
+}
+
+int64_t HdrHistogram::lowest_equivalent (int index) {
+	int bucket = (index >> sub_bucket_half_count_magnitude) - 1;
+	int64_t sub_bucket = (index & (sub_bucket_half_count - 1)) + sub_bucket_half_count;
+	if (bucket < 0) {
+		sub_bucket -= sub_bucket_half_count;
+		bucket = 0;
+	}
+	return sub_bucket << bucket;
+}
+
+int64_t HdrHistogram::highest_equivalent (int index) {
+	int bucket = std::max((index >> sub_bucket_half_count_magnitude) - 1, 0);
+	return lowest_equivalent(index) + ((int64_t) 1 << bucket) - 1;
+}
+
+void HdrHistogram::record (double value) {
+	double magnitude = fabs(value) / unit;
+	int index = index_of(magnitude < highest ? (int64_t) magnitude : highest);
+	counts[value < 0 ? zero_index - 1 - index : zero_index + index]++;
+	total++;
+	minv = std::min(minv, value);
+	maxv = std::max(maxv, value);
+}
+
+void HdrHistogram::merge (const HdrHistogram& other) {
+	assert(other.counts.size() == counts.size() && other.unit == unit);
+	for (size_t i = 0; i < counts.size(); i++) {
+		counts[i] += other.counts[i];
+	}
+	total += other.total;
+	minv = std::min(minv, other.minv);
+	maxv = std::max(maxv, other.maxv);
+}
+
+void HdrHistogram::clear () {
+	fill(counts.begin(), counts.end(), 0);
+	total = 0;
+	minv = INFINITY;
+	maxv = -INFINITY;
+}
+
+int64_t HdrHistogram::count () {
+	return total;
+}
+
+double HdrHistogram::min () {
+	return total > 0 ? minv : 0;
+}
+
+double HdrHistogram::max () {
+	return total > 0 ? maxv : 0;
+}
+
+double HdrHistogram::percentile (double p) {
+	if (total == 0) {
+		return 0;
+	}
+	int64_t target = std::max((int64_t) ceil(p / 100 * total), (int64_t) 1);
+	int64_t seen = 0;
+	double value = maxv;
+	bool found = false;
+	// from the most negative value up to the most positive one
+	for (int i = 0; i < (int) counts.size() && !found; i++) {
+		seen += counts[i];
+		if (seen >= target) {
+			value = (i < zero_index) ? -(double) lowest_equivalent(zero_index - 1 - i) * unit
+				: (double) highest_equivalent(i - zero_index) * unit;
+			found = true;
+		}
+	}
+	return std::min(std::max(value, minv), maxv);
+}
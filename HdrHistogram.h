@@ -0,0 +1,57 @@
+#ifndef _HDRHISTOGRAM_H_
+#define _HDRHISTOGRAM_H_
+
+#include <cstdint>
+#include <vector>
+
+
+/* High-dynamic-range histogram with log-linear buckets, in the style of HdrHistogram.
+ Values are counted as whole multiples of unit. Magnitudes below 2 * 10^sigdigits units
+ get a bucket each; above that every power-of-two range is split into the same number of
+ linear sub-buckets, so any recorded value is known to sigdigits significant digits.
+ Negative values are counted in a mirrored set of buckets below those of the non-negative
+ ones, in the same array. Recording is a few integer
+ operations and the memory is fixed by unit, highest and sigdigits. There is no locking:
+ give each thread its own histogram and merge them when reading. */
+class HdrHistogram {
+private:
+	double unit;
+	int64_t highest;	// largest magnitude tracked, in units; larger ones are counted as highest
+	int sigdigits;
+
+	int sub_bucket_count;	// linear sub-buckets per power of two
+	int sub_bucket_half_count;
+	int sub_bucket_half_count_magnitude;
+	int64_t sub_bucket_mask;
+	int bucket_count;
+
+	// counts of non-negative values from zero_index up by bucket index, and of negative values
+	// from zero_index - 1 down by the index of their magnitude
+	std::vector<int64_t> counts;
+	int zero_index;
+	int64_t total;
+	double minv, maxv;
+
+	int index_of (int64_t magnitude);
+	int64_t lowest_equivalent (int index);
+	int64_t highest_equivalent (int index);
+
+public:
+	HdrHistogram (double _unit, double _highest, int _sigdigits);
+	/* _highest is the largest magnitude that needs to be told apart from others,
+	 _sigdigits (1 to 5) the number of significant digits kept. */
+
+	void record (double value);
+	void merge (const HdrHistogram& other);
+	/* Adds the counts of other, which must have been created with the same arguments. */
+	void clear ();
+
+	int64_t count ();
+	double min ();
+	double max ();
+	double percentile (double p);
+	/* The value that p percent of the recorded values are at or below, to sigdigits
+	 significant digits (the upper end of its bucket, within the recorded min and max). */
+};
+
+#endif
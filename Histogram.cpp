@@ -1,26 +1,101 @@
 #include "Histogram.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HISTOGRAM_SIMD
+#endif
+
 using namespace std;
 
 
+#ifdef HISTOGRAM_SIMD
+/* Vector versions of Histogram::bin. Clamping happens before the truncating conversion, in
+ doubles, which gives the same bins as truncating first and clamping the integer (and sends
+ NaN to bin 0, since max picks its second operand). Each returns how many values it binned. */
+static size_t bin_batch_sse2 (const double* values, size_t n, int* bins, double start, double scale, int nbins) {
+	__m128d vstart = _mm_set1_pd(start);
+	__m128d vscale = _mm_set1_pd(scale);
+	__m128d vzero = _mm_setzero_pd();
+	__m128d vlast = _mm_set1_pd(nbins - 1);
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128d x = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(values + i), vstart), vscale);
+		x = _mm_min_pd(_mm_max_pd(x, vzero), vlast);
+		_mm_storel_epi64((__m128i*) (bins + i), _mm_cvttpd_epi32(x));
+	}
+	return i;
+}
+
+__attribute__((target("avx")))
+static size_t bin_batch_avx (const double* values, size_t n, int* bins, double start, double scale, int nbins) {
+	__m256d vstart = _mm256_set1_pd(start);
+	__m256d vscale = _mm256_set1_pd(scale);
+	__m256d vzero = _mm256_setzero_pd();
+	__m256d vlast = _mm256_set1_pd(nbins - 1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(values + i), vstart), vscale);
+		x = _mm256_min_pd(_mm256_max_pd(x, vzero), vlast);
+		_mm_storeu_si128((__m128i*) (bins + i), _mm256_cvttpd_epi32(x));
+	}
+	return i;
+}
+#endif
+
+
 Histogram::Histogram (int _nbins, double _start, double _end) : nbins (_nbins), start(_start), end(_end) {
 	hist = vector<int>(nbins, 0);
+	scale = nbins / (end - start);
 }
 
 Histogram::~Histogram () {}
 
 void Histogram::update (double value) {
-	int bin_index = (int) ((value - start) / (end - start) * nbins);
+	int bin_index = bin(value);
+
+	lck.lock();
+	hist[bin_index]++;
+	lck.unlock();
+}
+
+void Histogram::update_batch (const double* values, size_t n) {
+	int bins[BIN_BATCH];
+	lck.lock();
+	for (size_t i = 0; i < n; i += BIN_BATCH) {
+		size_t count = min(n - i, (size_t) BIN_BATCH);
+		bin_batch(values + i, count, bins);
+		for (size_t j = 0; j < count; j++) {
+			hist[bins[j]]++;
+		}
+	}
+	lck.unlock();
+}
+
+int Histogram::bin (double value) {
+	int bin_index = (int) ((value - start) * scale);
 	if (bin_index < 0) {
 		bin_index= 0;
     }
 	else if (bin_index >= nbins) {
 		bin_index = nbins-1;
     }
+	return bin_index;
+}
 
-	lck.lock();
-	hist[bin_index]++;
-	lck.unlock();
+void Histogram::bin_batch (const double* values, size_t n, int* bins) {
+	size_t i = 0;
+#ifdef HISTOGRAM_SIMD
+	static const bool has_avx = __builtin_cpu_supports("avx");
+	if (has_avx) {
+		i = bin_batch_avx(values, n, bins, start, scale, nbins);
+	}
+	else {
+		i = bin_batch_sse2(values, n, bins, start, scale, nbins);
+	}
+#endif
+	for (; i < n; i++) {
+		bins[i] = bin(values[i]);
+	}
 }
 
 int Histogram::size () {
@@ -1,15 +1,20 @@
 #ifndef _HISTOGRAM_H_
 #define _HISTOGRAM_H_
 
+#include <cstddef>
 #include <mutex>
 #include <vector>
 
+// values binned per pass of update_batch, kept on the stack
+#define BIN_BATCH 64
+
 
 class Histogram {
 private:
 	std::vector<int> hist;
 	int nbins;
 	double start, end;
+	double scale; // nbins / (end - start), so finding a bin is a multiply instead of a divide
 
 	std::mutex lck;
 
@@ -18,6 +23,12 @@ public:
 	~Histogram ();
 
 	void update (double value);
+    void update_batch (const double* values, size_t n);
+    /* Counts n values, taking the lock once for the whole batch. */
+    int bin (double value);
+    /* index of the bin that value falls into; values outside the range go to the first or last bin */
+    void bin_batch (const double* values, size_t n, int* bins);
+    /* bins[i] = bin(values[i]), computed with SSE2/AVX vector instructions where available */
     int size ();
 
 	std::vector<double> get_range ();
@@ -1,16 +1,86 @@
 #include <iomanip>
 #include <iostream>
+#include <new>
 #include <string.h>
 #include "HistogramCollection.h"
 
 using namespace std;
 
+#define CACHE_LINE 64
 
-HistogramCollection::HistogramCollection () {
+
+HistogramShard::HistogramShard (const vector<Histogram*>& _hists, double _unit, double _highest, int _sigdigits)
+    : hists(_hists), hdr_unit(_unit), hdr_highest(_highest), hdr_sigdigits(_sigdigits) {
+    ncounts = 0;
+    for (auto hist : hists) {
+        offsets.push_back(ncounts);
+        ncounts += hist->size();
+    }
+    size_t bytes = (ncounts * sizeof(int) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    counts = (int*) operator new[](max(bytes, (size_t) CACHE_LINE), align_val_t(CACHE_LINE));
+    memset(counts, 0, ncounts * sizeof(int));
+    if (hdr_sigdigits > 0) {
+        hdrs.resize(hists.size());
+    }
+}
+
+HistogramShard::~HistogramShard () {
+    operator delete[](counts, align_val_t(CACHE_LINE));
+}
+
+void HistogramShard::update (int pno, double val) {
+    counts[offsets[pno-1] + hists[pno-1]->bin(val)]++;
+    if (!hdrs.empty()) {
+        hdr_of(pno).record(val);
+    }
+}
+
+void HistogramShard::update_batch (int pno, const double* vals, size_t n) {
+    int bins[BIN_BATCH];
+    int* hcounts = counts + offsets[pno-1];
+    for (size_t i = 0; i < n; i += BIN_BATCH) {
+        size_t nbinned = min(n - i, (size_t) BIN_BATCH);
+        hists[pno-1]->bin_batch(vals + i, nbinned, bins);
+        for (size_t j = 0; j < nbinned; j++) {
+            hcounts[bins[j]]++;
+        }
+    }
+    if (!hdrs.empty()) {
+        HdrHistogram& hdr = hdr_of(pno);
+        for (size_t i = 0; i < n; i++) {
+            hdr.record(vals[i]);
+        }
+    }
+}
+
+// a shard only pays for the HdrHistograms of the persons its thread actually sees
+HdrHistogram& HistogramShard::hdr_of (int pno) {
+    if (!hdrs[pno-1]) {
+        hdrs[pno-1].reset(new HdrHistogram(hdr_unit, hdr_highest, hdr_sigdigits));
+    }
+    return *hdrs[pno-1];
+}
+
+int HistogramShard::count (int pno, int bin) {
+    return counts[offsets[pno-1] + bin];
+}
+
+const HdrHistogram* HistogramShard::hdr (int pno) {
+    return hdrs.empty() ? nullptr : hdrs[pno-1].get();
+}
+
+
+HistogramCollection::HistogramCollection () : hdr_unit(0), hdr_highest(0), hdr_sigdigits(0) {
     hists = vector<Histogram*>();
 }
 
 HistogramCollection::~HistogramCollection () {
+    for (auto shard : shards) {
+        delete shard;
+    }
+    for (auto hdr : hdrs) {
+        delete hdr;
+    }
     for (auto hist : hists) {
         delete hist;
     }
@@ -23,6 +93,61 @@ void HistogramCollection::add (Histogram* hist) {
 
 void HistogramCollection::update (int pno, double val) {
     hists[pno-1]->update(val);
+    if (!hdrs.empty()) {
+        lock_guard<mutex> lock(hdrs_lock);
+        hdrs[pno-1]->record(val);
+    }
+}
+
+void HistogramCollection::update_batch (int pno, const double* vals, size_t n) {
+    hists[pno-1]->update_batch(vals, n);
+    if (!hdrs.empty()) {
+        lock_guard<mutex> lock(hdrs_lock);
+        for (size_t i = 0; i < n; i++) {
+            hdrs[pno-1]->record(vals[i]);
+        }
+    }
+}
+
+void HistogramCollection::track_percentiles (double unit, double highest, int sigdigits) {
+    hdr_unit = unit;
+    hdr_highest = highest;
+    hdr_sigdigits = sigdigits;
+    for (size_t j = hdrs.size(); j < hists.size(); j++) {
+        hdrs.push_back(new HdrHistogram(unit, highest, sigdigits));
+    }
+}
+
+HistogramShard* HistogramCollection::new_shard () {
+    HistogramShard* shard = new HistogramShard(hists, hdr_unit, hdr_highest, hdrs.empty() ? 0 : hdr_sigdigits);
+    lock_guard<mutex> lock(shards_lock);
+    shards.push_back(shard);
+    return shard;
+}
+
+vector<vector<int>> HistogramCollection::snapshot () {
+    vector<vector<int>> counts;
+    lock_guard<mutex> lock(shards_lock);
+    for (size_t j = 0; j < hists.size(); j++) {
+        counts.push_back(hists[j]->get_hist());
+        for (auto shard : shards) {
+            for (size_t i = 0; i < counts[j].size(); i++) {
+                counts[j][i] += shard->count(j+1, i);
+            }
+        }
+    }
+    return counts;
+}
+
+HdrHistogram HistogramCollection::hdr_snapshot (int pno) {
+    HdrHistogram merged = *hdrs[pno-1];
+    lock_guard<mutex> lock(shards_lock);
+    for (auto shard : shards) {
+        if (shard->hdr(pno)) {
+            merged.merge(*shard->hdr(pno));
+        }
+    }
+    return merged;
 }
 
 void HistogramCollection::print () {
@@ -31,6 +156,7 @@ void HistogramCollection::print () {
         cout << "Histogram collection is empty" << endl;
         return;
     }
+    vector<vector<int>> counts = snapshot();
 
     int* sum = new int[nhists];
     memset(sum, 0, nhists*sizeof(int));
@@ -49,8 +175,8 @@ void HistogramCollection::print () {
     for (int i = 0; i < nbins; i++) {
         printf("[%5.2f,%5.2f): ", st, st + delta);
         for (int j = 0; j < nhists; j++) {
-            cout << setw(5) << hists[j]->get_hist()[i] << " "; 
-            sum[j] += hists[j]->get_hist()[i];
+            cout << setw(5) << counts[j][i] << " "; 
+            sum[j] += counts[j][i];
         }
         cout << endl;
         st += delta;
@@ -68,4 +194,33 @@ void HistogramCollection::print () {
     cout << endl;
 
     delete[] sum;
+
+    if (hdrs.empty()) {
+        return;
+    }
+
+    // percentiles of the full range of values, not clamped into the end bins
+    vector<HdrHistogram> merged;
+    for (int j = 0; j < nhists; j++) {
+        merged.push_back(hdr_snapshot(j+1));
+    }
+    for (int i = 0; i < ndots; i++) {
+        cout << "-";
+    }
+    cout << endl;
+
+    double percentiles[] = {50, 90, 99, 99.9};
+    const char* labels[] = {"p50", "p90", "p99", "p99.9"};
+    for (int i = 0; i < 4; i++) {
+        printf("%-13s: ", labels[i]);
+        for (int j = 0; j < nhists; j++) {
+            printf("%5.2f ", merged[j].percentile(percentiles[i]));
+        }
+        cout << endl;
+    }
+    printf("%-13s: ", "max");
+    for (int j = 0; j < nhists; j++) {
+        printf("%5.2f ", merged[j].max());
+    }
+    cout << endl;
 }
@@ -1,20 +1,79 @@
 #ifndef _HISTOGRAMCOLLECTION_H_
 #define _HISTOGRAMCOLLECTION_H_
 
+#include <memory>
+#include <mutex>
 #include <vector>
+#include "HdrHistogram.h"
 #include "Histogram.h"
 
+/* One thread's private bin counts for every histogram of a collection. The owning thread
+ counts into it without locks or atomics; the collection adds all shards up when it is read.
+ The counts start on their own cache line and are padded to whole lines, so shards of
+ different threads never share one. When the collection tracks percentiles, the shard
+ also records every value into an HdrHistogram of its own, created for a person when the
+ first value of that person arrives. */
+class HistogramShard {
+private:
+    std::vector<Histogram*> hists;
+    std::vector<int> offsets;   // first count of each histogram
+    int* counts;
+    int ncounts;
+    std::vector<std::unique_ptr<HdrHistogram>> hdrs; // empty unless percentiles are tracked
+    double hdr_unit, hdr_highest;
+    int hdr_sigdigits;
+
+    HdrHistogram& hdr_of (int pno);
+
+public:
+    HistogramShard (const std::vector<Histogram*>& _hists, double _unit, double _highest, int _sigdigits);
+    /* _sigdigits is 0 unless the shard tracks percentiles, see HdrHistogram for the others. */
+    ~HistogramShard ();
+
+    void update (int pno, double val);
+    void update_batch (int pno, const double* vals, size_t n);
+    int count (int pno, int bin);
+    const HdrHistogram* hdr (int pno);
+    /* nullptr if no value of person pno was recorded in this shard. */
+};
+
 class HistogramCollection{
 private:
     // collection of histograms
     std::vector<Histogram*> hists;
 
+    // shards handed out by new_shard
+    std::vector<HistogramShard*> shards;
+    std::mutex shards_lock;
+
+    // log-linear histograms of the same values, one per person; empty unless percentiles are tracked
+    std::vector<HdrHistogram*> hdrs;
+    std::mutex hdrs_lock;
+    double hdr_unit, hdr_highest;
+    int hdr_sigdigits;
+
 public:
     HistogramCollection ();
     ~HistogramCollection ();
     
     void add (Histogram* hist);
+    void track_percentiles (double unit, double highest, int sigdigits);
+    /* Also keeps an HdrHistogram per person (see HdrHistogram for the arguments), so print
+     shows percentiles below the bin table. Call it after all histograms are added and
+     before any shard is requested. */
     void update (int pno, double val);
+    void update_batch (int pno, const double* vals, size_t n);
+    /* Counts n values of person pno with one lock acquisition (see Histogram::update_batch). */
+
+    HistogramShard* new_shard ();
+    /* Returns a shard for one thread to update instead of calling update. Request it after
+     all histograms are added; the collection owns it. */
+
+    std::vector<std::vector<int>> snapshot ();
+    /* Bin counts of every histogram, including all shards. Shards are read without
+     synchronization, so only take a snapshot once the threads updating them are joined. */
+    HdrHistogram hdr_snapshot (int pno);
+    /* The merged HdrHistogram of person pno, under the same rule as snapshot. */
     
     void print ();
 };
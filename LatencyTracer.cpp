@@ -0,0 +1,70 @@
+#include <chrono>
+#include <iostream>
+#include "LatencyTracer.h"
+
+using namespace std;
+
+// latencies are kept in microseconds, to 2 significant digits, up to 10 seconds
+#define TRACE_UNIT 1.0
+#define TRACE_HIGHEST 10e6
+#define TRACE_DIGITS 2
+#define NUM_TRACED_TYPES (CHUNK_MSG + 1)
+
+
+TraceShard::TraceShard () : hists(NUM_TRACED_TYPES * NUM_STAGES) {}
+
+void TraceShard::record (MESSAGE_TYPE mtype, Stage stage, int64_t start_ns, int64_t end_ns) {
+	unique_ptr<HdrHistogram>& hist = hists[mtype * NUM_STAGES + stage];
+	if (!hist) {
+		hist.reset(new HdrHistogram(TRACE_UNIT, TRACE_HIGHEST, TRACE_DIGITS));
+	}
+	hist->record((end_ns - start_ns) / 1000.0);
+}
+
+HdrHistogram* TraceShard::get (MESSAGE_TYPE mtype, Stage stage) {
+	return hists[mtype * NUM_STAGES + stage].get();
+}
+
+
+LatencyTracer::LatencyTracer () {}
+
+LatencyTracer::~LatencyTracer () {
+	for (auto shard : shards) {
+		delete shard;
+	}
+}
+
+int64_t LatencyTracer::now () {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceShard* LatencyTracer::new_shard () {
+	TraceShard* shard = new TraceShard();
+	lock_guard<mutex> lock(lck);
+	shards.push_back(shard);
+	return shard;
+}
+
+void LatencyTracer::print () {
+	const char* type_names[NUM_TRACED_TYPES] = {"UNKNOWN", "DATA", "FILE", "NEWCHANNEL", "QUIT", "DATA_RANGE", "SEQ", "CHUNK"};
+	const char* stage_names[TraceShard::NUM_STAGES] = {"queue", "channel", "end-to-end"};
+
+	printf("%-22s %10s %10s %10s %10s\n", "Latency (us)", "count", "p50", "p99", "max");
+	lock_guard<mutex> lock(lck);
+	for (int t = 0; t < NUM_TRACED_TYPES; t++) {
+		for (int s = 0; s < TraceShard::NUM_STAGES; s++) {
+			HdrHistogram merged(TRACE_UNIT, TRACE_HIGHEST, TRACE_DIGITS);
+			for (auto shard : shards) {
+				HdrHistogram* hist = shard->get((MESSAGE_TYPE) t, (TraceShard::Stage) s);
+				if (hist) {
+					merged.merge(*hist);
+				}
+			}
+			if (merged.count() == 0) {
+				continue;
+			}
+			printf("%-11s %-10s %10ld %10.0f %10.0f %10.0f\n", type_names[t], stage_names[s], (long) merged.count(),
+				merged.percentile(50), merged.percentile(99), merged.max());
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef _LATENCYTRACER_H_
+#define _LATENCYTRACER_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "common.h"
+#include "HdrHistogram.h"
+
+
+/* Latency distributions of the client's requests, per message type and per stage:
+ QUEUE_STAGE from being pushed into the request buffer until a worker sends it,
+ CHANNEL_STAGE the round trip on the channel, and END_TO_END_STAGE from being pushed until
+ the response is consumed (counted by a histogram thread, or written to the received file).
+ Every thread records into its own TraceShard; print merges them. */
+class TraceShard {
+public:
+	enum Stage {QUEUE_STAGE, CHANNEL_STAGE, END_TO_END_STAGE, NUM_STAGES};
+
+private:
+	// created on first use: most threads only see one or two (type, stage) pairs
+	std::vector<std::unique_ptr<HdrHistogram>> hists;
+
+public:
+	TraceShard ();
+
+	void record (MESSAGE_TYPE mtype, Stage stage, int64_t start_ns, int64_t end_ns);
+	HdrHistogram* get (MESSAGE_TYPE mtype, Stage stage);
+	/* nullptr if nothing was recorded for mtype and stage */
+};
+
+class LatencyTracer {
+private:
+	std::vector<TraceShard*> shards;
+	std::mutex lck;
+
+public:
+	LatencyTracer ();
+	~LatencyTracer ();
+
+	static int64_t now ();
+	/* monotonic time in nanoseconds */
+
+	TraceShard* new_shard ();
+	/* Returns a shard for one thread; the tracer owns it. */
+
+	void print ();
+	/* Prints p50, p99 and max in microseconds for every type and stage that was recorded.
+	 Only call it once the recording threads are joined. */
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "MQRequestChannel.h"
+
+using namespace std;
+
+// upper bound on the bytes queued in one direction of a channel
+#define MQ_QUEUE_BYTES 2048
+
+/*--------------------------------------------------------------------------*/
+/*		CONSTRUCTOR/DESTRUCTOR FOR CLASS	M Q R e q u e s t C h a n n e l	*/
+/*--------------------------------------------------------------------------*/
+
+MQRequestChannel::MQRequestChannel (const string _name, const Side _side, int _len) : RequestChannel(_name, _side), len(_len) {
+	mq1 = "/mq_" + my_name + "1";
+	mq2 = "/mq_" + my_name + "2";
+
+	if (_side == SERVER_SIDE) {
+		wmq = open_mq(mq1, O_WRONLY);
+		rmq = open_mq(mq2, O_RDONLY);
+	}
+	else {
+		rmq = open_mq(mq1, O_RDONLY);
+		wmq = open_mq(mq2, O_WRONLY);
+	}
+
+	// a queue left over from an earlier run keeps its old message size
+	struct mq_attr attr;
+	mq_getattr(rmq, &attr);
+	rlen = attr.mq_msgsize;
+	rbuf = new char[rlen];
+}
+
+MQRequestChannel::~MQRequestChannel () {
+	mq_close(wmq);
+	mq_close(rmq);
+
+	// only the server side removes the names, the client may be done before the server attaches
+	if (my_side == SERVER_SIDE) {
+		mq_unlink(mq1.c_str());
+		mq_unlink(mq2.c_str());
+	}
+	delete[] rbuf;
+}
+
+/*--------------------------------------------------------------------------*/
+/*			MEMBER FUNCTIONS FOR CLASS	M Q R e q u e s t C h a n n e l		*/
+/*--------------------------------------------------------------------------*/
+
+mqd_t MQRequestChannel::open_mq (string _mq_name, int mode) {
+	struct mq_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.mq_maxmsg = max(1, min(10, MQ_QUEUE_BYTES / len));
+	attr.mq_msgsize = len;
+
+	mqd_t mqd = mq_open(_mq_name.c_str(), mode | O_CREAT, 0600, &attr);
+	if (mqd == (mqd_t) -1) {
+		EXITONERROR(_mq_name);
+	}
+	return mqd;
+}
+
+int MQRequestChannel::cread (void* msgbuf, int msgsize) {
+	ssize_t nbytes;
+	while ((nbytes = mq_receive(rmq, rbuf, rlen, nullptr)) < 0) {
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+	nbytes = min((int) nbytes, msgsize);
+	memcpy(msgbuf, rbuf, nbytes);
+	return nbytes;
+}
+
+int MQRequestChannel::cwrite (void* msgbuf, int msgsize) {
+	int nbytes = min(msgsize, len);
+	while (mq_send(wmq, (const char*) msgbuf, nbytes, 0) < 0) {
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+	return nbytes;
+}
+
+int MQRequestChannel::poll_fd () {
+	return (int) rmq;
+}
@@ -0,0 +1,44 @@
+#ifndef _MQRequestChannel_H_
+#define _MQRequestChannel_H_
+
+#include <mqueue.h>
+
+#include "RequestChannel.h"
+
+
+class MQRequestChannel : public RequestChannel {
+private:
+	/*  The current implementation uses two POSIX message queues, one per direction. */
+	mqd_t wmq;
+	mqd_t rmq;
+
+	std::string mq1, mq2;
+	int len;
+	int rlen;
+	char* rbuf; // mq_receive needs room for a full-size message of the read queue
+
+	mqd_t open_mq (std::string _mq_name, int mode);
+
+public:
+	MQRequestChannel (const std::string _name, const Side _side, int _len = MAX_MESSAGE);
+	/* Creates or attaches to the message queues of the channel with the given name. _len
+	 is the largest message a queue accepts and must match on both sides. Each queue holds
+	 a few messages at once, fewer for large _len so that a hundred channels stay within
+	 the default RLIMIT_MSGQUEUE. System limits (fs.mqueue.queues_max, msgsize_max) cap how
+	 many channels and how large _len can be; exceeding them is reported and exits. */
+
+	~MQRequestChannel ();
+	/* Closes the queues. The server side also unlinks them. */
+
+	int cread (void* msgbuf, int msgsize) override;
+	/* Receives exactly one message. Message boundaries are preserved: a message longer
+	 than msgsize is truncated and the rest discarded. */
+
+	int cwrite (void* msgbuf, int msgsize) override;
+	/* Sends msgsize bytes as one message, truncated to the queue's message size. */
+
+	int poll_fd () override;
+	/* On Linux a message queue descriptor is a file descriptor and can be polled. */
+};
+
+#endif
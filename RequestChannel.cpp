@@ -0,0 +1,41 @@
+#include "RequestChannel.h"
+#include "FIFORequestChannel.h"
+#include "SHMRequestChannel.h"
+#include "MQRequestChannel.h"
+
+using namespace std;
+
+
+RequestChannel::RequestChannel (const string _name, const Side _side) : my_name(_name), my_side(_side) {}
+
+RequestChannel::~RequestChannel () {}
+
+int RequestChannel::cwrite_file (int fd, __int64_t offset, int length, char* buf) {
+	int nbytes = 0;
+	while (nbytes < length) {
+		int r = pread(fd, buf + nbytes, length - nbytes, offset + nbytes);
+		if (r <= 0) {
+			return -1;
+		}
+		nbytes += r;
+	}
+	return cwrite(buf, nbytes);
+}
+
+int RequestChannel::poll_fd () {
+	return -1;
+}
+
+string RequestChannel::name () {
+	return my_name;
+}
+
+RequestChannel* create_channel (char ipc, const string _name, const RequestChannel::Side _side, int _len) {
+	if (ipc == 's') {
+		return new SHMRequestChannel(_name, _side, _len);
+	}
+	else if (ipc == 'q') {
+		return new MQRequestChannel(_name, _side, _len);
+	}
+	return new FIFORequestChannel(_name, _side);
+}
@@ -0,0 +1,49 @@
+#ifndef _REQUESTCHANNEL_H_
+#define _REQUESTCHANNEL_H_
+
+#include "common.h"
+
+
+class RequestChannel {
+public:
+	enum Side {SERVER_SIDE, CLIENT_SIDE};
+	enum Mode {READ_MODE, WRITE_MODE};
+
+protected:
+	std::string my_name;
+	Side my_side;
+
+public:
+	RequestChannel (const std::string _name, const Side _side);
+	/* Common base of the IPC transports. A channel has two ends, "SERVER_SIDE" and
+	 "CLIENT_SIDE"; every transport keeps the same request/response semantics, so client
+	 and server code only deal with RequestChannel pointers. */
+
+	virtual ~RequestChannel ();
+
+	virtual int cread (void* msgbuf, int msgsize) = 0;
+	/* Blocking read of at most msgsize bytes into msgbuf. Returns the number of bytes
+	 read, or -1 if the read fails. */
+
+	virtual int cwrite (void* msgbuf, int msgsize) = 0;
+	/* Writes msgsize bytes from msgbuf to the channel. Returns the number of bytes
+	 written, or -1 if the write fails. */
+
+	virtual int cwrite_file (int fd, __int64_t offset, int length, char* buf);
+	/* Writes length bytes of the open file fd, starting at offset, to the channel as one
+	 message. Transports backed by a pipe move the bytes in the kernel; the default reads
+	 them into buf (at least length bytes) and cwrite()s that. Returns the number of bytes
+	 written, or -1 if reading the file or writing the channel fails. */
+
+	virtual int poll_fd ();
+	/* Returns a descriptor that becomes readable when a message is waiting, for use with
+	 poll/epoll, or -1 if the transport has none. */
+
+	std::string name ();
+};
+
+RequestChannel* create_channel (char ipc, const std::string _name, const RequestChannel::Side _side, int _len);
+/* Creates the channel end for the transport selected by ipc: 'f' for named pipes,
+ 's' for POSIX shared memory, 'q' for POSIX message queues. _len is the largest message the channel has to carry. */
+
+#endif
@@ -0,0 +1,227 @@
+#include "RequestScheduler.h"
+#include "common.h"
+
+using namespace std;
+
+
+RequestScheduler::RequestScheduler (Mode _mode, int _nworkers, int _cap, BoundedBuffer::Backend backend, int _slot_size)
+	: mode(_mode), nworkers(max(_nworkers, 1)), cap(_cap), slot_size(_slot_size), deque_cap(0), next_deque(0),
+	nactive(max(_nworkers, 1)), queued(0), inflight(0), sleepers(0), blocked(0), closed(false), nstolen(0), npushed(0) {
+	if (mode == SHARED_MODE) {
+		shared.reset(new BoundedBuffer(_cap, backend, _slot_size));
+		return;
+	}
+	deque_cap = max((_cap + nworkers - 1) / nworkers, 1);
+	deques.reset(new WorkDeque[nworkers]);
+	for (int i = 0; i < nworkers; i++) {
+		deques[i].slots.resize(deque_cap * slot_size);
+		deques[i].lengths.resize(deque_cap);
+	}
+}
+
+void RequestScheduler::push (char* msg, int size) {
+	MESSAGE_TYPE m = UNKNOWN_MSG;
+	if (size >= (int) sizeof(MESSAGE_TYPE)) {
+		memcpy(&m, msg, sizeof(MESSAGE_TYPE));
+	}
+	if (mode == STEAL_MODE && m == QUIT_MSG) {
+		close();
+		return;
+	}
+	push_n(msg, size, &size, 1);
+}
+
+void RequestScheduler::push_n (char* msgs, int stride, int* sizes, int n) {
+	if (mode == SHARED_MODE) {
+		shared->push_n(msgs, stride, sizes, n);
+		return;
+	}
+
+	int i = 0;
+	int tickets = 0; // requests admitted under cap that are not in a deque yet
+	int active = nactive;
+	int d = next_deque++ % active;
+	while (i < n) {
+		// the deques together can hold more than cap, so each request first takes one of cap tickets
+		tickets += admit(n - i - tickets);
+		bool full = (tickets == 0);
+		int tries = 0;
+		for (; tries < active && tickets > 0; tries++, d = (d + 1) % active) {
+			WorkDeque& dq = deques[d];
+			int added = 0;
+			{
+				lock_guard<mutex> lock(dq.lck);
+				int count = dq.count.load();
+				while (tickets > 0 && count < deque_cap) {
+					int slot = (dq.head + count) % deque_cap;
+					int len = min(sizes[i], slot_size);
+					memcpy(dq.slots.data() + slot * slot_size, msgs + i * stride, len);
+					dq.lengths[slot] = len;
+					count++;
+					i++;
+					tickets--;
+					added++;
+				}
+				dq.count = count;
+			}
+			if (added > 0) {
+				queued += added;
+				npushed += added;
+				// sleepers is raised under lck before the sleeper checks queued, so one side always sees the other
+				if (sleepers > 0) {
+					lock_guard<mutex> lock(lck);
+					if (added > 1) {
+						work_cond.notify_all();
+					}
+					else {
+						work_cond.notify_one();
+					}
+				}
+				break;
+			}
+		}
+		if (tries == active) {
+			// every deque is full: hand back the tickets that found no room
+			inflight -= tickets;
+			tickets = 0;
+			full = true;
+		}
+		if (full) {
+			// cap requests are in flight, or every deque is full
+			unique_lock<mutex> lock(lck);
+			blocked++;
+			space_cond.wait(lock, [this] { return has_space(); });
+			blocked--;
+			active = nactive;
+			d = d % active;
+		}
+	}
+}
+
+int RequestScheduler::admit (int n) {
+	int current = inflight.load();
+	int granted;
+	do {
+		granted = min(n, cap - current);
+		if (granted <= 0) {
+			return 0;
+		}
+	} while (!inflight.compare_exchange_weak(current, current + granted));
+	return granted;
+}
+
+bool RequestScheduler::has_space () {
+	if (inflight >= cap) {
+		return false;
+	}
+	for (int i = 0; i < nactive; i++) {
+		if (deques[i].count < deque_cap) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// moves up to n requests out of dq, from the back if newest, from the front otherwise
+int RequestScheduler::take (WorkDeque& dq, bool newest, char* msgs, int stride, int* sizes, int n) {
+	if (dq.count.load(memory_order_relaxed) == 0) {
+		return 0;
+	}
+	int taken = 0;
+	{
+		lock_guard<mutex> lock(dq.lck);
+		int count = dq.count.load();
+		// a thief leaves the victim at least half of what it has
+		int want = newest ? min(n, count) : min(n, (count + 1) / 2);
+		for (; taken < want; taken++) {
+			int slot;
+			if (newest) {
+				slot = (dq.head + count - 1) % deque_cap;
+			}
+			else {
+				slot = dq.head;
+				dq.head = (dq.head + 1) % deque_cap;
+			}
+			count--;
+			sizes[taken] = min(dq.lengths[slot], stride);
+			memcpy(msgs + taken * stride, dq.slots.data() + slot * slot_size, sizes[taken]);
+		}
+		dq.count = count;
+	}
+	if (taken > 0) {
+		queued -= taken;
+		inflight -= taken;
+		if (blocked > 0) {
+			lock_guard<mutex> lock(lck);
+			space_cond.notify_all();
+		}
+	}
+	return taken;
+}
+
+int RequestScheduler::try_pop_n (int worker, char* msgs, int stride, int* sizes, int n) {
+	if (mode == SHARED_MODE) {
+		return shared->try_pop_n(msgs, stride, sizes, n);
+	}
+
+	int count = take(deques[worker % nworkers], true, msgs, stride, sizes, n);
+	for (int j = 1; count == 0 && j < nworkers; j++) {
+		count = take(deques[(worker + j) % nworkers], false, msgs, stride, sizes, n);
+		nstolen += count;
+	}
+	return count;
+}
+
+int RequestScheduler::pop_n (int worker, char* msgs, int stride, int* sizes, int n) {
+	if (mode == SHARED_MODE) {
+		return shared->pop_n(msgs, stride, sizes, n);
+	}
+
+	while (true) {
+		int count = try_pop_n(worker, msgs, stride, sizes, n);
+		if (count > 0) {
+			return count;
+		}
+		unique_lock<mutex> lock(lck);
+		sleepers++;
+		work_cond.wait(lock, [this] { return queued > 0 || closed; });
+		sleepers--;
+		if (closed && queued == 0) {
+			MESSAGE_TYPE q = QUIT_MSG;
+			memcpy(msgs, &q, sizeof(MESSAGE_TYPE));
+			sizes[0] = sizeof(MESSAGE_TYPE);
+			return 1;
+		}
+	}
+}
+
+void RequestScheduler::close () {
+	lock_guard<mutex> lock(lck);
+	closed = true;
+	work_cond.notify_all();
+}
+
+void RequestScheduler::set_active (int n) {
+	if (mode == SHARED_MODE) {
+		return;
+	}
+	lock_guard<mutex> lock(lck);
+	nactive = min(max(n, 1), nworkers);
+	space_cond.notify_all();
+}
+
+int RequestScheduler::depth () {
+	return (mode == SHARED_MODE) ? shared->size() : queued.load();
+}
+
+int RequestScheduler::capacity () {
+	return (mode == SHARED_MODE) ? cap : min(cap, nactive * deque_cap);
+}
+
+long RequestScheduler::stolen () {
+	return nstolen.load();
+}
+
+long RequestScheduler::pushed () {
+	return npushed.load();
+}
@@ -0,0 +1,90 @@
+#ifndef _REQUESTSCHEDULER_H_
+#define _REQUESTSCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "BoundedBuffer.h"
+
+
+/* Hands the producers' requests to the workers of the client.
+ SHARED_MODE is the original single request_buffer that every worker pops from.
+ STEAL_MODE gives every worker a deque of its own. Producers spread their batches over
+ the deques round-robin; a worker pops the newest requests of its own deque, and when that
+ is empty it steals the oldest half (at most n) of another worker's. A worker whose channel
+ is slow therefore does not hold requests the others could serve, and each lock is only
+ shared by one owner and the occasional thief.
+ Each deque holds ceil(cap / nworkers) requests, at least one, and all of them together
+ never more than cap: a push first takes a ticket from a shared count of requests in flight.
+ Producers block while cap requests are in flight or every deque is full. set_active
+ narrows the deques producers push to, for workers that are parked; whatever is left in the
+ others still gets stolen. Pushing a QUIT_MSG closes the deques: once they are drained,
+ every pop returns a QUIT_MSG. */
+class RequestScheduler {
+public:
+	enum Mode {SHARED_MODE, STEAL_MODE};
+
+private:
+	struct WorkDeque {
+		std::mutex lck;
+		std::vector<char> slots;
+		std::vector<int> lengths;
+		int head = 0;
+		std::atomic<int> count{0}; // read without the lock to skip empty victims
+	};
+
+	Mode mode;
+	std::unique_ptr<BoundedBuffer> shared;
+
+	int nworkers;
+	int cap;
+	int slot_size;
+	int deque_cap;
+	std::unique_ptr<WorkDeque[]> deques;
+	std::atomic<unsigned> next_deque;
+	std::atomic<int> nactive; // producers only push to the first nactive deques
+
+	// requests in all deques; workers sleep on work_cond while it is 0, producers on space_cond while it is full
+	std::atomic<int> queued;
+	std::atomic<int> inflight; // queued plus admitted by a producer that has not placed them yet, at most cap
+	std::atomic<int> sleepers;
+	std::atomic<int> blocked;
+	bool closed;
+	std::mutex lck;
+	std::condition_variable work_cond;
+	std::condition_variable space_cond;
+
+	std::atomic<long> nstolen;
+	std::atomic<long> npushed;
+
+	int admit (int n);
+	int take (WorkDeque& dq, bool newest, char* msgs, int stride, int* sizes, int n);
+	bool has_space ();
+	void close ();
+
+public:
+	RequestScheduler (Mode _mode, int _nworkers, int _cap, BoundedBuffer::Backend backend, int _slot_size);
+
+	void push (char* msg, int size);
+	void push_n (char* msgs, int stride, int* sizes, int n);
+	/* Same contract as BoundedBuffer::push_n; in STEAL_MODE the batch goes to the next deque
+	 with room, spilling into the following ones. */
+
+	int pop_n (int worker, char* msgs, int stride, int* sizes, int n);
+	int try_pop_n (int worker, char* msgs, int stride, int* sizes, int n);
+	/* Same contract as BoundedBuffer::pop_n/try_pop_n for worker number worker. */
+
+	void set_active (int n);
+	/* Workers 0..n-1 are serving requests (STEAL_MODE only). */
+	int depth ();
+	int capacity ();
+	/* Requests waiting to be popped, and how many producers can push before they block. */
+
+	long stolen ();
+	long pushed ();
+	/* Requests taken from another worker's deque, and requests pushed; 0 in SHARED_MODE. */
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "SHMRequestChannel.h"
+
+using namespace std;
+
+/*--------------------------------------------------------------------------*/
+/*		CONSTRUCTOR/DESTRUCTOR FOR CLASS	S H M Q u e u e				*/
+/*--------------------------------------------------------------------------*/
+
+SHMQueue::SHMQueue (const string _name, int _len) : my_shm_name(_name), len(_len) {
+	int fd = shm_open(my_shm_name.c_str(), O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		EXITONERROR("shm_open " + my_shm_name);
+	}
+	// both sides size the segment identically, so it does not matter who gets here first
+	if (ftruncate(fd, sizeof(int) + len) < 0) {
+		EXITONERROR("ftruncate " + my_shm_name);
+	}
+	segment = (char*) mmap(nullptr, sizeof(int) + len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (segment == MAP_FAILED) {
+		EXITONERROR("mmap " + my_shm_name);
+	}
+
+	// sem_open with O_CREAT only applies the initial value if the semaphore is new
+	full = sem_open((my_shm_name + "_full").c_str(), O_CREAT, 0600, 0);
+	empty = sem_open((my_shm_name + "_empty").c_str(), O_CREAT, 0600, 1);
+	if (full == SEM_FAILED || empty == SEM_FAILED) {
+		EXITONERROR("sem_open " + my_shm_name);
+	}
+}
+
+SHMQueue::~SHMQueue () {
+	sem_close(full);
+	sem_close(empty);
+	munmap(segment, sizeof(int) + len);
+}
+
+/*--------------------------------------------------------------------------*/
+/*			MEMBER FUNCTIONS FOR CLASS	S H M Q u e u e					*/
+/*--------------------------------------------------------------------------*/
+
+int SHMQueue::shm_read (void* msgbuf, int msgsize) {
+	while (sem_wait(full) < 0) {
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+	int nbytes = min(*((int*) segment), msgsize);
+	memcpy(msgbuf, segment + sizeof(int), nbytes);
+	sem_post(empty);
+	return nbytes;
+}
+
+int SHMQueue::shm_write (void* msgbuf, int msgsize) {
+	while (sem_wait(empty) < 0) {
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+	int nbytes = min(msgsize, len);
+	memcpy(segment + sizeof(int), msgbuf, nbytes);
+	*((int*) segment) = nbytes;
+	sem_post(full);
+	return nbytes;
+}
+
+void SHMQueue::unlink () {
+	shm_unlink(my_shm_name.c_str());
+	sem_unlink((my_shm_name + "_full").c_str());
+	sem_unlink((my_shm_name + "_empty").c_str());
+}
+
+/*--------------------------------------------------------------------------*/
+/*		CONSTRUCTOR/DESTRUCTOR FOR CLASS	S H M R e q u e s t C h a n n e l	*/
+/*--------------------------------------------------------------------------*/
+
+SHMRequestChannel::SHMRequestChannel (const string _name, const Side _side, int _len) : RequestChannel(_name, _side) {
+	shmq1 = new SHMQueue("/shm_" + my_name + "1", _len);
+	shmq2 = new SHMQueue("/shm_" + my_name + "2", _len);
+
+	if (_side == SERVER_SIDE) {
+		wq = shmq1;
+		rq = shmq2;
+	}
+	else {
+		rq = shmq1;
+		wq = shmq2;
+	}
+}
+
+SHMRequestChannel::~SHMRequestChannel () {
+	/* only the server side removes the names: the client may finish with a channel
+	 before the server has attached to it */
+	if (my_side == SERVER_SIDE) {
+		shmq1->unlink();
+		shmq2->unlink();
+	}
+	delete shmq1;
+	delete shmq2;
+}
+
+/*--------------------------------------------------------------------------*/
+/*			MEMBER FUNCTIONS FOR CLASS	S H M R e q u e s t C h a n n e l	*/
+/*--------------------------------------------------------------------------*/
+
+int SHMRequestChannel::cread (void* msgbuf, int msgsize) {
+	return rq->shm_read(msgbuf, msgsize);
+}
+
+int SHMRequestChannel::cwrite (void* msgbuf, int msgsize) {
+	return wq->shm_write(msgbuf, msgsize);
+}
@@ -0,0 +1,60 @@
+#ifndef _SHMRequestChannel_H_
+#define _SHMRequestChannel_H_
+
+#include <semaphore.h>
+#include <sys/mman.h>
+
+#include "RequestChannel.h"
+
+
+class SHMQueue {
+private:
+	/* One direction of a shared-memory channel: a POSIX shared-memory segment holding a
+	 length header followed by a buffer of len bytes, and two named semaphores. "full" is
+	 posted when a message is waiting in the segment, "empty" when the segment is free. */
+	std::string my_shm_name;
+	int len;
+	char* segment;
+
+	sem_t* full;
+	sem_t* empty;
+
+public:
+	SHMQueue (const std::string _name, int _len);
+	~SHMQueue ();
+
+	int shm_read (void* msgbuf, int msgsize);
+	int shm_write (void* msgbuf, int msgsize);
+
+	void unlink ();
+};
+
+
+class SHMRequestChannel : public RequestChannel {
+private:
+	/*  The request and response areas are two SHMQueues. */
+	SHMQueue* shmq1;
+	SHMQueue* shmq2;
+
+	SHMQueue* wq;
+	SHMQueue* rq;
+
+public:
+	SHMRequestChannel (const std::string _name, const Side _side, int _len = MAX_MESSAGE);
+	/* Creates or attaches to the shared-memory channel with the given name. Both sides may
+	 come up in either order: the segments and semaphores are created by whichever side
+	 arrives first. _len is the largest message each direction can hold; longer writes
+	 are truncated to it. Both sides must pass the same _len. */
+
+	~SHMRequestChannel ();
+	/* Unmaps the segments. The server side also unlinks the segments and semaphores. */
+
+	int cread (void* msgbuf, int msgsize) override;
+	/* Blocks until a message is available. Message boundaries are preserved: a message
+	 longer than msgsize is truncated and the rest discarded. */
+
+	int cwrite (void* msgbuf, int msgsize) override;
+	/* Blocks until the peer has consumed the previous message, then writes this one. */
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include <sys/mman.h>
+#include <climits>
+#include "Snapshot.h"
+#include "common.h"
+
+using namespace std;
+
+
+ecg_trace parsed_trace::view () const {
+	ecg_trace t;
+	t.time = time.data();
+	t.ecg1 = ecg1.data();
+	t.ecg2 = ecg2.data();
+	t.nrows = (int) time.size();
+	return t;
+}
+
+bool parse_csv_trace (const string& filename, parsed_trace& trace) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	if (st.st_size == 0) {
+		close(fd);
+		return true;
+	}
+
+	// map the whole file read-only and parse it in place
+	const char* data = (const char*) mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		EXITONERROR("mmap " + filename);
+	}
+	madvise((void*) data, st.st_size, MADV_SEQUENTIAL);
+	const char* end = data + st.st_size;
+
+	// size the columns up front from the line count
+	size_t nlines = 0;
+	for (const char* nl = data; (nl = (const char*) memchr(nl, '\n', end - nl)) != nullptr; nl++) {
+		nlines++;
+	}
+	// rows are indexed with an int (ecg_trace::nrows)
+	if (nlines >= INT_MAX) {
+		munmap((void*) data, st.st_size);
+		return false;
+	}
+	trace.time.reserve(nlines + 1);
+	trace.ecg1.reserve(nlines + 1);
+	trace.ecg2.reserve(nlines + 1);
+
+	// each line is "time,ecg1,ecg2"
+	const char* p = data;
+	while (p < end) {
+		if (*p == '\n' || *p == '\r') {
+			p++;
+			continue;
+		}
+		trace.time.push_back(parse_double(p, end));
+		p += (p < end && *p == ',');
+		trace.ecg1.push_back(parse_double(p, end));
+		p += (p < end && *p == ',');
+		trace.ecg2.push_back(parse_double(p, end));
+		while (p < end && *p != '\n') {
+			p++;
+		}
+	}
+
+	munmap((void*) data, st.st_size);
+	return true;
+}
+
+
+uint64_t snapshot_checksum (const char* data, size_t len) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool write_snapshot (const string& filename, const vector<parsed_trace>& traces) {
+	// the body is everything after the header: the person table, then the columns
+	size_t table_size = traces.size() * sizeof(snapshot_person);
+	size_t body_size = table_size;
+	for (auto& t : traces) {
+		body_size += 3 * t.time.size() * sizeof(double);
+	}
+	vector<char> body(body_size);
+
+	size_t offset = sizeof(snapshot_header) + table_size;
+	char* column = body.data() + table_size;
+	for (size_t i = 0; i < traces.size(); i++) {
+		const parsed_trace& t = traces[i];
+		snapshot_person person;
+		person.offset = offset;
+		person.nrows = t.time.size();
+		memcpy(body.data() + i * sizeof(snapshot_person), &person, sizeof(snapshot_person));
+
+		size_t col_size = t.time.size() * sizeof(double);
+		// empty columns have no data() to copy from
+		if (col_size > 0) {
+			memcpy(column, t.time.data(), col_size);
+			memcpy(column + col_size, t.ecg1.data(), col_size);
+			memcpy(column + 2 * col_size, t.ecg2.data(), col_size);
+		}
+		column += 3 * col_size;
+		offset += 3 * col_size;
+	}
+
+	snapshot_header header;
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.npersons = traces.size();
+	header.checksum = snapshot_checksum(body.data(), body.size());
+
+	string tmpname = filename + ".tmp";
+	int fd = ::open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	bool ok = write(fd, &header, sizeof(header)) == (ssize_t) sizeof(header);
+	for (size_t done = 0; ok && done < body.size(); ) {
+		ssize_t n = write(fd, body.data() + done, body.size() - done);
+		ok = n > 0;
+		done += ok ? n : 0;
+	}
+	ok = (close(fd) == 0) && ok;
+	if (!ok || rename(tmpname.c_str(), filename.c_str()) < 0) {
+		unlink(tmpname.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+Snapshot::Snapshot (const char* _data, size_t _size) : data(_data), size(_size) {}
+
+Snapshot::~Snapshot () {
+	munmap((void*) data, size);
+}
+
+Snapshot* Snapshot::open (const string& filename, string& error) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		error = "no snapshot " + filename;
+		return nullptr;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	size_t size = st.st_size;
+	if (size < sizeof(snapshot_header)) {
+		close(fd);
+		error = filename + " is too short to be a snapshot";
+		return nullptr;
+	}
+	// shared, so every server mapping the file reads the same page-cache pages
+	const char* data = (const char*) mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		error = "cannot map " + filename;
+		return nullptr;
+	}
+	Snapshot* snapshot = new Snapshot(data, size);
+
+	snapshot_header header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+		error = filename + " is not a snapshot";
+	}
+	else if (header.version != SNAPSHOT_VERSION) {
+		error = filename + " has version " + to_string(header.version) + ", expected " + to_string(SNAPSHOT_VERSION);
+	}
+	else if (sizeof(snapshot_header) + header.npersons * sizeof(snapshot_person) > size) {
+		error = filename + " is truncated";
+	}
+	else {
+		for (uint32_t i = 0; i < header.npersons && error.empty(); i++) {
+			snapshot_person person;
+			memcpy(&person, data + sizeof(snapshot_header) + i * sizeof(snapshot_person), sizeof(person));
+			// columns are read in place as doubles, so they must be aligned and inside the file
+			if (person.offset % sizeof(double) != 0 || person.offset > size
+				|| person.nrows > (size - person.offset) / (3 * sizeof(double))) {
+				error = filename + " has a bad column offset for person " + to_string(i + 1);
+			}
+			else if (person.nrows > INT_MAX) {
+				error = filename + " has more rows than fit in an int for person " + to_string(i + 1);
+			}
+		}
+	}
+	if (!error.empty()) {
+		delete snapshot;
+		return nullptr;
+	}
+	return snapshot;
+}
+
+int Snapshot::persons () const {
+	return ((const snapshot_header*) data)->npersons;
+}
+
+ecg_trace Snapshot::trace (int person) const {
+	const snapshot_person* table = (const snapshot_person*) (data + sizeof(snapshot_header));
+	const snapshot_person& p = table[person - 1];
+	ecg_trace t;
+	t.time = (const double*) (data + p.offset);
+	t.ecg1 = t.time + p.nrows;
+	t.ecg2 = t.ecg1 + p.nrows;
+	t.nrows = p.nrows;
+	return t;
+}
+
+bool Snapshot::verify () const {
+	uint64_t checksum = ((const snapshot_header*) data)->checksum;
+	return snapshot_checksum(data + sizeof(snapshot_header), size - sizeof(snapshot_header)) == checksum;
+}
@@ -0,0 +1,83 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define SNAPSHOT_FILE "BIMDC/snapshot.bin"
+#define SNAPSHOT_MAGIC "BIMDCSNP"
+#define SNAPSHOT_VERSION 1
+
+
+/* ECG trace of one person as contiguous columns. Row i holds the sample at time i * 0.004
+ seconds. The columns point either into a snapshot mapping or into a parsed_trace. */
+struct ecg_trace {
+	const double* time = nullptr;
+	const double* ecg1 = nullptr;
+	const double* ecg2 = nullptr;
+	int nrows = 0;
+};
+
+// columns parsed from one BIMDC/<person>.csv
+struct parsed_trace {
+	std::vector<double> time;
+	std::vector<double> ecg1;
+	std::vector<double> ecg2;
+
+	ecg_trace view () const;
+};
+
+bool parse_csv_trace (const std::string& filename, parsed_trace& trace);
+/* Parses a "time,ecg1,ecg2" file into trace. Returns false if the file cannot be opened or
+ has more rows than an int can index. */
+
+
+/* Snapshot file layout; all integers are little-endian as written by the host:
+   snapshot_header
+   snapshot_person[npersons]
+   for each person: time[nrows], ecg1[nrows], ecg2[nrows] as doubles
+ checksum is FNV-1a over everything after the header. */
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t npersons;
+	uint64_t checksum;
+};
+
+struct snapshot_person {
+	uint64_t offset; // byte offset of the time column; ecg1 and ecg2 follow it
+	uint64_t nrows;
+};
+
+uint64_t snapshot_checksum (const char* data, size_t len);
+
+bool write_snapshot (const std::string& filename, const std::vector<parsed_trace>& traces);
+/* Writes the traces (person 1 first) to a temporary file and renames it over filename,
+ so servers that still map the old snapshot keep a consistent copy. */
+
+
+/* Read-only, shared mapping of a snapshot file. Opening only checks the header and that
+ every column lies inside the file and has at most INT_MAX rows, which takes the same time
+ for any dataset size; the pages are only read when requests touch them, and all servers
+ mapping the file share them through the page cache. verify() recomputes the checksum over
+ the whole file and is left to "mksnapshot -v", since it reads every page. */
+class Snapshot {
+private:
+	const char* data;
+	size_t size;
+
+	Snapshot (const char* _data, size_t _size);
+
+public:
+	static Snapshot* open (const std::string& filename, std::string& error);
+	/* Returns nullptr, with the reason in error, if the file is missing or malformed. */
+	~Snapshot ();
+
+	int persons () const;
+	ecg_trace trace (int person) const;
+	/* Columns of person (1-based), pointing into the mapping. */
+	bool verify () const;
+};
+
+#endif
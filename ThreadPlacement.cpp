@@ -0,0 +1,114 @@
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include "ThreadPlacement.h"
+#include "common.h"
+
+using namespace std;
+
+
+vector<int> ThreadPlacement::parse_cpu_list (const string& list) {
+	vector<int> cpus;
+	for (auto& range : split(list, ',')) {
+		vector<string> ends = split(range, '-');
+		// split drops a trailing separator, so "3-" has to be caught first
+		if (range.empty() || range.back() == '-' || ends.size() > 2 || ends[0].empty() || ends.back().empty()
+			|| ends[0].find_first_not_of("0123456789") != string::npos
+			|| ends.back().find_first_not_of("0123456789") != string::npos
+			|| ends[0].size() > 4 || ends.back().size() > 4) {
+			return {};
+		}
+		int lo = stoi(ends[0]);
+		int hi = stoi(ends.back());
+		for (int cpu = lo; cpu <= hi; cpu++) {
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+string ThreadPlacement::select (const string& spec, const string& classes) {
+	string selected;
+	for (auto& part : split(spec, '/')) {
+		if (part == "auto" || (part.size() > 1 && part[1] == '=' && classes.find(part[0]) != string::npos)) {
+			selected += (selected.empty() ? "" : "/") + part;
+		}
+	}
+	return selected;
+}
+
+ThreadPlacement::ThreadPlacement (const string& spec, const string& classes) : automatic(false) {
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(cpu_set_t), &allowed);
+
+	for (auto& part : split(spec, '/')) {
+		if (part == "auto") {
+			automatic = true;
+			continue;
+		}
+		vector<int> cpus;
+		if (part.size() > 2 && part[1] == '=' && classes.find(part[0]) != string::npos) {
+			cpus = parse_cpu_list(part.substr(2));
+		}
+		if (cpus.empty()) {
+			cerr << "Bad -x part \"" << part << "\": expected auto or <class>=<cpus> with a class of \"" << classes << "\"" << endl;
+			exit(1);
+		}
+		for (int cpu : cpus) {
+			if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)) {
+				cerr << "CPU " << cpu << " in -x " << part << " is not available" << endl;
+				exit(1);
+			}
+		}
+		lists[part[0]] = cpus;
+	}
+
+	// group the allowed CPUs by the hardware threads of their core
+	vector<bool> grouped(CPU_SETSIZE, false);
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed) || grouped[cpu]) {
+			continue;
+		}
+		vector<int> core = {cpu};
+		grouped[cpu] = true;
+		ifstream in("/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/thread_siblings_list");
+		string siblings;
+		if (in >> siblings) {
+			for (int sibling : parse_cpu_list(siblings)) {
+				if (sibling < CPU_SETSIZE && CPU_ISSET(sibling, &allowed) && !grouped[sibling]) {
+					core.push_back(sibling);
+					grouped[sibling] = true;
+				}
+			}
+		}
+		cores.push_back(core);
+	}
+}
+
+bool ThreadPlacement::pin (thread& t, int cpu) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &set) == 0;
+}
+
+bool ThreadPlacement::is_auto () {
+	return automatic;
+}
+
+bool ThreadPlacement::pin_class (thread& t, char cls, int index) {
+	auto it = lists.find(cls);
+	if (it == lists.end()) {
+		return false;
+	}
+	return pin(t, it->second[index % it->second.size()]);
+}
+
+bool ThreadPlacement::pin_channel (thread& t, int channel, bool server_side) {
+	if (!automatic || cores.empty()) {
+		return false;
+	}
+	const vector<int>& core = cores[(max(channel, 1) - 1) % cores.size()];
+	return pin(t, (server_side && core.size() > 1) ? core[1] : core[0]);
+}
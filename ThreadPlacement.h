@@ -0,0 +1,45 @@
+#ifndef _THREADPLACEMENT_H_
+#define _THREADPLACEMENT_H_
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* CPU placement of threads, set with -x on the client and the server.
+ The spec is a list of parts separated by '/'. A part "<class>=<cpus>" pins every thread of
+ that class to one CPU of the list, round-robin by the thread's index; cpus is a list such
+ as "0-3,8". The part "auto" pairs every data channel with a physical core: channel k gets
+ core (k-1) mod ncores, its client worker runs on the core's first hardware thread and its
+ server thread on a sibling of it (or the same thread on cores without SMT), so request and
+ reply stay in one core's caches. Threads a channel thread starts inherit its CPU.
+ Classes the spec does not mention are left to the kernel scheduler. */
+class ThreadPlacement {
+private:
+	std::map<char, std::vector<int>> lists;
+	bool automatic;
+	// the CPUs this process may run on, grouped by physical core
+	std::vector<std::vector<int>> cores;
+
+	bool pin (std::thread& t, int cpu);
+
+public:
+	static std::vector<int> parse_cpu_list (const std::string& list);
+	/* "0-3,8" -> {0, 1, 2, 3, 8}; an empty vector if the list is malformed. */
+	static std::string select (const std::string& spec, const std::string& classes);
+	/* The parts of spec for one of classes, and auto, joined with '/' again; "" if none. */
+
+	ThreadPlacement (const std::string& spec, const std::string& classes);
+	/* classes holds the class letters the program knows. Exits with a message if the spec
+	 names another class or a CPU this process cannot run on. */
+
+	bool is_auto ();
+	bool pin_class (std::thread& t, char cls, int index);
+	/* Pins t to CPU index (mod the list's size) of its class; false if the class is not pinned. */
+	bool pin_channel (std::thread& t, int channel, bool server_side);
+	/* Pins the thread of data channel number channel (1-based) on the given side by the
+	 automatic layout; false if the spec does not ask for it. */
+};
+
+#endif
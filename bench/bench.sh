@@ -0,0 +1,90 @@
+#!/usr/bin/env bash
+
+# Sweeps client/server parameters and appends one CSV row per run.
+# Run through "make bench", which builds ./server and ./client without the sanitizers first.
+#
+# The grid is set through the environment, each a space-separated list:
+#   WORKERS (-w), HISTS (-h), BUFFERS (-b), MSGSIZES (-m), TRANSPORTS (-i: f, s, q),
+#   SCHEDULERS (-s: shared, steal), PLACEMENTS (-x of the client, e.g. auto or w=0-3/c=4-7;
+#   the c and e classes go to the server it forks; none leaves every thread to the kernel)
+# and single values:
+#   REPEATS   runs per configuration
+#   N, P      requests per patient and patients (data runs)
+#   FILE      file in BIMDC/ to transfer instead of requesting data points
+#   EXTRA     extra client arguments, e.g. "-q ring -k 8" or "-r"
+#   OUT       CSV file to append to
+#
+# Columns: wall time, and user/system CPU time of the client and the server together.
+# A data run counts N*P data points as its requests and 8 bytes per point; a file run counts
+# the file size, with one request per m bytes (fewer if the client negotiates larger chunks).
+
+cd "$(dirname "$0")/.." || exit 1
+
+WORKERS=${WORKERS:-"10 50 100"}
+HISTS=${HISTS:-"20"}
+BUFFERS=${BUFFERS:-"10 100"}
+MSGSIZES=${MSGSIZES:-"256"}
+TRANSPORTS=${TRANSPORTS:-"f"}
+SCHEDULERS=${SCHEDULERS:-"shared"}
+PLACEMENTS=${PLACEMENTS:-"none"}
+REPEATS=${REPEATS:-3}
+N=${N:-1000}
+P=${P:-10}
+FILE=${FILE:-""}
+EXTRA=${EXTRA:-""}
+OUT=${OUT:-bench/results.csv}
+
+if [ ! -f "$OUT" ]; then
+    echo "transport,workers,hist_threads,buffer,msg_size,scheduler,placement,file,extra,run,wall_s,user_s,sys_s,requests_per_s,mb_per_s,status" > "$OUT"
+fi
+
+TIMEFORMAT='%R %U %S'
+for ipc in $TRANSPORTS; do
+for w in $WORKERS; do
+for h in $HISTS; do
+for b in $BUFFERS; do
+for m in $MSGSIZES; do
+for s in $SCHEDULERS; do
+for x in $PLACEMENTS; do
+    placement=""
+    if [ "$x" != "none" ]; then
+        placement="-x $x"
+    fi
+for run in $(seq 1 "$REPEATS"); do
+    if [ -n "$FILE" ]; then
+        args="-w $w -b $b -m $m -i $ipc -s $s $placement -f $FILE $EXTRA"
+        bytes=$(stat -c %s "BIMDC/$FILE")
+        requests=$(( (bytes + m - 1) / m ))
+    else
+        args="-n $N -p $P -w $w -h $h -b $b -m $m -i $ipc -s $s $placement $EXTRA"
+        requests=$(( N * P ))
+        bytes=$(( requests * 8 ))
+    fi
+
+    # bash's time reports the client together with the server it forks and waits for
+    timing=$( { time ./client $args >/dev/null 2>&1; } 2>&1 )
+    rc=$?
+    status=ok
+    if [ $rc -ne 0 ]; then
+        status="exit$rc"
+    elif [ -n "$FILE" ] && ! cmp -s "BIMDC/$FILE" "received/$FILE"; then
+        status=mismatch
+    fi
+    read -r wall user sys <<< "$timing"
+
+    echo "$ipc,$w,$h,$b,$m,$s,\"$x\",$FILE,$EXTRA,$run,$wall,$user,$sys,$(echo "$requests $bytes $wall" | awk '{ printf "%.1f,%.3f", $1 / $3, $2 / 1e6 / $3 }'),$status" >> "$OUT"
+    echo "$args (run $run): ${wall}s $status"
+
+    # leftovers of a failed run would break the next one
+    find . -maxdepth 1 -type p -name 'fifo_*' -exec rm {} +
+    rm -f /dev/shm/shm_* /dev/shm/sem.shm_* /dev/mqueue/mq_* 2>/dev/null
+done
+done
+done
+done
+done
+done
+done
+done
+
+echo "Results appended to $OUT"
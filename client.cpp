@@ -1,5 +1,12 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <sys/time.h>
 #include <sys/wait.h>
@@ -8,102 +15,663 @@
 #include "common.h"
 #include "Histogram.h"
 #include "HistogramCollection.h"
-#include "FIFORequestChannel.h"
+#include "LatencyTracer.h"
+#include "RequestChannel.h"
+#include "RequestScheduler.h"
+#include "ThreadPlacement.h"
 
 // ecgno to use for datamsgs
 #define ECCNO 1
+// how often the adaptive pool (-a) samples the workers and resizes
+#define ADAPT_INTERVAL_MS 50
 
 using namespace std;
 
 
-void patient_thread_function (BoundedBuffer& request_buffer, int n, int p_num) {
+// reads exactly size bytes of a response; transports like FIFOs may hand back a long reply in pieces
+int read_response (RequestChannel* chan, char* buf, int size) {
+    int nread = 0;
+    while (nread < size) {
+        int nbytes = chan->cread(buf + nread, size - nread);
+        if (nbytes <= 0) {
+            break;
+        }
+        nread += nbytes;
+    }
+    return nread;
+}
+
+/* The copy of a transferred file under received/. It is preallocated to its full size once,
+ and every worker writes the chunks it receives straight to their offsets with pwrite, so
+ chunks may land in any order and no thread serializes the writes. Chunks are whole multiples
+ of a unit of bytes (the last one may be shorter); one bit per unit records what has been written. */
+class ReceivedFile {
+private:
+    int fd;
+    __int64_t size;
+    int unit;
+    int chunk;      // largest chunk the server will send
+    __int64_t nchunks;
+    unique_ptr<atomic<uint64_t>[]> done;
+    atomic<__int64_t> nreceived;
+
+public:
+    ReceivedFile (const string& path, __int64_t _size, int _unit, int _chunk) : size(_size), unit(_unit), chunk(_chunk), nreceived(0) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            EXITONERROR(path);
+        }
+        // reserve the blocks up front; file systems without fallocate just get the size set
+        if (size > 0 && fallocate(fd, 0, 0, size) < 0 && ftruncate(fd, size) < 0) {
+            EXITONERROR(path);
+        }
+        nchunks = (size + unit - 1) / unit;
+        int nwords = (nchunks + 63) / 64;
+        done.reset(new atomic<uint64_t>[nwords]);
+        for (int i = 0; i < nwords; i++) {
+            done[i].store(0);
+        }
+    }
+
+    ~ReceivedFile () {
+        close(fd);
+    }
+
+    void write (__int64_t offset, const char* data, int length) {
+        int nwritten = 0;
+        while (nwritten < length) {
+            int nbytes = pwrite(fd, data + nwritten, length - nwritten, offset + nwritten);
+            if (nbytes < 0) {
+                EXITONERROR("pwrite");
+            }
+            nwritten += nbytes;
+        }
+        for (__int64_t i = offset / unit; i < (offset + length + unit - 1) / unit; i++) {
+            done[i / 64].fetch_or(1ULL << (i % 64));
+        }
+        nreceived += length;
+    }
+
+    __int64_t file_size () {
+        return size;
+    }
+
+    int max_chunk () {
+        return chunk;
+    }
+
+    // bytes written so far
+    __int64_t received () {
+        return nreceived.load();
+    }
+
+    // number of units that have not been written yet
+    __int64_t missing () {
+        __int64_t count = 0;
+        for (__int64_t i = 0; i < nchunks; i++) {
+            if (!(done[i / 64].load() & (1ULL << (i % 64)))) {
+                count++;
+            }
+        }
+        return count;
+    }
+};
+
+/* A response on its way to the histogram threads. The trace fields only travel through
+ response_buffer when tracing; otherwise responses are response_size(nullptr) bytes long. */
+struct response_t {
+    int person;
+    double value;
+    int64_t pushed_ns;  // when the request was pushed into request_buffer
+    MESSAGE_TYPE mtype;
+};
+
+int response_size (LatencyTracer* tracer) {
+    return tracer ? sizeof(response_t) : offsetof(response_t, pushed_ns);
+}
+
+/* The workers that serve requests in adaptive mode (-a). Workers with an index at or above
+ active() park until the controller raises it again; their channels stay open, so they
+ resume without another NEWCHANNEL_MSG. Every reply a worker gets is counted together with
+ its round-trip time, which the controller samples. */
+class WorkerPool {
+private:
+    atomic<int> nactive;
+    bool stopped;
+    mutex lck;
+    condition_variable cond;
+    atomic<long> nreplies;
+    atomic<int64_t> rtt_ns;
+
+public:
+    WorkerPool (int _active) : nactive(_active), stopped(false), nreplies(0), rtt_ns(0) {}
+
+    // blocks worker id while it is parked
+    void wait_turn (int id) {
+        if (id < nactive) {
+            return;
+        }
+        unique_lock<mutex> lock(lck);
+        cond.wait(lock, [this, id] { return id < nactive; });
+    }
+
+    void set_active (int n) {
+        lock_guard<mutex> lock(lck);
+        nactive = n;
+        cond.notify_all();
+    }
+
+    int active () {
+        return nactive;
+    }
+
+    void record (int64_t ns) {
+        nreplies++;
+        rtt_ns += ns;
+    }
+
+    long replies () {
+        return nreplies.load();
+    }
+
+    int64_t rtt () {
+        return rtt_ns.load();
+    }
+
+    // sleeps for ms milliseconds or until stop; returns whether the pool was stopped
+    bool wait_stop (int ms) {
+        unique_lock<mutex> lock(lck);
+        return cond.wait_for(lock, chrono::milliseconds(ms), [this] { return stopped; });
+    }
+
+    void stop () {
+        lock_guard<mutex> lock(lck);
+        stopped = true;
+        cond.notify_all();
+    }
+};
+
+// pushes n requests with push_n; when tracing, each carries the time it was pushed in
+// 8 extra bytes after the request, which pop_request removes again
+void push_requests (RequestScheduler& request_buffer, LatencyTracer* tracer, char* msgs, int stride, int* sizes, int n) {
+    if (!tracer) {
+        request_buffer.push_n(msgs, stride, sizes, n);
+        return;
+    }
+    int traced_stride = stride + sizeof(int64_t);
+    vector<char> traced(n * traced_stride);
+    vector<int> traced_sizes(n);
+    int64_t now = LatencyTracer::now();
+    for (int i = 0; i < n; i++) {
+        memcpy(traced.data() + i * traced_stride, msgs + i * stride, sizes[i]);
+        memcpy(traced.data() + i * traced_stride + sizes[i], &now, sizeof(int64_t));
+        traced_sizes[i] = sizes[i] + sizeof(int64_t);
+    }
+    request_buffer.push_n(traced.data(), traced_stride, traced_sizes.data(), n);
+}
+
+// strips the push time from a popped request (see push_requests) and returns it; 0 when not tracing
+int64_t pop_request (char* msg, int& size, LatencyTracer* tracer) {
+    int64_t pushed_ns = 0;
+    if (tracer && *((MESSAGE_TYPE*) msg) != QUIT_MSG) {
+        size -= sizeof(int64_t);
+        memcpy(&pushed_ns, msg + size, sizeof(int64_t));
+    }
+    return pushed_ns;
+}
+
+void patient_thread_function (RequestScheduler& request_buffer, LatencyTracer* tracer, int n, int p_num, int k) {
     // functionality of the patient threads
 
     // take a patient p_num
     // for n requests, produce a datamsg (p_num, time, ECGNO) and push to request_buffer
     //      - time dependent on current requests:
     //      - at 0 -> time = 0.000; at 1 -> time = 0.004, at 2 -> time = 0.008; ...
+    //      - requests are pushed k at a time with push_n
+    vector<datamsg> batch;
+    vector<int> sizes(k, sizeof(datamsg));
+    batch.reserve(k);
     for (int i = 0; i < n; i++) {
-
         double time = i * 0.004;
-        //std::cout << "patient_thread function_running with p_num= " << p_num << " time= " << time << " ecgno= " << ECGNO << std::endl;
-        datamsg dmsg(p_num, time, ECCNO);
-        request_buffer.push((char*)&dmsg, sizeof(datamsg));
+        batch.push_back(datamsg(p_num, time, ECCNO));
+        if ((int) batch.size() == k || i == n - 1) {
+            push_requests(request_buffer, tracer, (char*) batch.data(), sizeof(datamsg), sizes.data(), batch.size());
+            batch.clear();
+        }
     }
+}
 
+void patient_range_thread_function (RequestScheduler& request_buffer, LatencyTracer* tracer, int n, int p_num, int m, int k) {
+    // same as patient_thread_function, but each request asks for as many consecutive
+    // points as fit in one m-byte response
+    int per_request = max(1, m / (int) sizeof(double));
+    vector<datarangemsg> batch;
+    vector<int> sizes(k, sizeof(datarangemsg));
+    batch.reserve(k);
+    for (int i = 0; i < n; i += per_request) {
+        double time = i * 0.004;
+        batch.push_back(datarangemsg(p_num, time, ECCNO, min(per_request, n - i)));
+        if ((int) batch.size() == k || i + per_request >= n) {
+            push_requests(request_buffer, tracer, (char*) batch.data(), sizeof(datarangemsg), sizes.data(), batch.size());
+            batch.clear();
+        }
+    }
 }
 
-void file_thread_function (BoundedBuffer& request_buffer, const string& file_name, int file_size) {
+void file_thread_function (RequestScheduler& request_buffer, LatencyTracer* tracer, const string& file_name, ReceivedFile& file, int m, int w, int k) {
     // functionality of the file thread
 
-    // file 
-    // open output file; allocate the memory fseek; close the file
-    // while offset < file_size, produce a filemsg(offset, m)+filename and push to request_buffer
+    // while offset < file_size, produce a filemsg(offset, chunk)+filename and push to request_buffer
     //      - incrementing offset; and be careful with the final message
-    ifstream file(file_name, ios::binary | ios::ate);
-    int offset = 0;
-    
+    //      - requests are pushed k at a time with push_n
+    //      - chunk starts at m; after every w chunks the throughput the workers achieved is
+    //        measured, and chunk keeps doubling (or halving) while that improves and turns
+    //        around when it drops, staying a multiple of m no larger than the negotiated maximum
+    //      - a chunk is never so large that the rest of the file would not go to all w workers
+    int len = sizeof(filemsg) + file_name.size() + 1;
+    vector<char> batch(k * len);
+    vector<int> sizes(k, len);
+    int count = 0;
+
+    __int64_t file_size = file.file_size();
+    int max_chunk = max(m, file.max_chunk() / m * m);
+    int chunk = m;
+    bool growing = true;
+    double last_rate = 0;
+    int epoch_chunks = 0;
+    auto epoch_start = chrono::steady_clock::now();
+    __int64_t epoch_received = file.received();
+
+    __int64_t offset = 0;
     while (offset < file_size) {
-        int remaining_size = min(MAX_MESSAGE, file_size - offset);
+        if (epoch_chunks == max(w, 4)) {
+            auto now = chrono::steady_clock::now();
+            double rate = (file.received() - epoch_received) / max(chrono::duration<double>(now - epoch_start).count(), 1e-9);
+            if (rate < 0.9 * last_rate) {
+                growing = !growing;
+            }
+            chunk = growing ? min(chunk * 2, max_chunk) : max(chunk / 2 / m * m, m);
+            last_rate = rate;
+            epoch_chunks = 0;
+            epoch_start = now;
+            epoch_received = file.received();
+        }
+        int this_chunk = chunk;
+        while (this_chunk > m && (file_size - offset) / this_chunk < w) {
+            this_chunk = max(this_chunk / 2 / m * m, m);
+        }
+        epoch_chunks++;
+
+        int remaining_size = (int) min((__int64_t) this_chunk, file_size - offset);
         filemsg fmsg(offset, remaining_size);
-        //std::cout << "file_thread function running with offset= " << offset << " remaining_size= " << remaining_size << std::endl;
+        char* req = batch.data() + count * len;
+        memcpy(req, &fmsg, sizeof(filemsg));
+        strcpy(req + sizeof(filemsg), file_name.c_str());
+        count++;
 
-        request_buffer.push((char*)&fmsg, sizeof(filemsg));
-        
         offset += remaining_size;
+        if (count == k || offset >= file_size) {
+            push_requests(request_buffer, tracer, batch.data(), len, sizes.data(), count);
+            count = 0;
+        }
     }
-    file.close();
 }
 
-void worker_thread_function (BoundedBuffer& request_buffer, BoundedBuffer& response_buffer, FIFORequestChannel* chan) {
+void worker_thread_function (RequestScheduler& request_buffer, BoundedBuffer& response_buffer, int id, RequestChannel* chan, ReceivedFile* file, LatencyTracer* tracer, WorkerPool* pool, int m, int k) {
     // functionality of the worker threads
 
     // forever loop
-    // pop message from the request_buffer
+    // pop up to k messages from the request_buffer (this worker's deque, or stolen, when work stealing)
     // view line 120 in server (process_request function) fow how to decide current message
     // send the message across the FIFO channel, collect response
     // if DATA:
     //      - create pair of p_no from message and response from server
-    //      - push that pair to the response_buffer
+    //      - push the batch of pairs to the response_buffer
+    // if DATA_RANGE:
+    //      - unpack the array of doubles into one pair per data point
     // if FILE:
-    //      - collec the filename from the message
-    //      - open the file in update mode
-    //      - fseek(SEEK_SET) to offset of the filemesg
-    //      - write the buffer from the server
+    //      - write the chunk from the server to its offset in the received file
+    // if QUIT:
+    //      - put the quit message back for the next worker and exit
+    // when tracing, the time each request waited in request_buffer and its round trip on the
+    // channel are recorded, and file chunks also their end-to-end time once written
+    // in adaptive mode, wait while parked and count each round trip in the pool
+    vector<char> requests(k * m);
+    vector<int> sizes(k);
+    int max_points = max(1, m / (int) sizeof(double));
+    vector<response_t> responses(k * max_points);
+    vector<int> response_sizes(k * max_points, response_size(tracer));
+    char* file_buffer = new char[file ? max(m, file->max_chunk()) : m];
+    TraceShard* trace = tracer ? tracer->new_shard() : nullptr;
+
+    bool done = false;
+    while (!done) {
+        if (pool) {
+            pool->wait_turn(id);
+        }
+        int count = request_buffer.pop_n(id, requests.data(), m, sizes.data(), k);
+        int nresponses = 0;
+
+        for (int i = 0; i < count; i++) {
+            char* msg_buffer = requests.data() + i * m;
+            MESSAGE_TYPE* msg_type = (MESSAGE_TYPE*) msg_buffer;
+            int64_t pushed_ns = pop_request(msg_buffer, sizes[i], tracer);
+            int64_t sent_ns = (trace || pool) ? LatencyTracer::now() : 0;
+
+            if (*msg_type == DATA_MSG) {
+                datamsg* dmsg = (datamsg*) msg_buffer;
+                double reply;
+                chan->cwrite(msg_buffer, sizeof(datamsg));
+                chan->cread(&reply, sizeof(double));
+                responses[nresponses++] = {dmsg->person, reply, pushed_ns, DATA_MSG};
+            } else if (*msg_type == DATA_RANGE_MSG) {
+                datarangemsg* rmsg = (datarangemsg*) msg_buffer;
+                chan->cwrite(msg_buffer, sizeof(datarangemsg));
+                int npoints = read_response(chan, file_buffer, rmsg->count * sizeof(double)) / sizeof(double);
+                double* points = (double*) file_buffer;
+                for (int j = 0; j < npoints; j++) {
+                    responses[nresponses++] = {rmsg->person, points[j], pushed_ns, DATA_RANGE_MSG};
+                }
+            } else if (*msg_type == FILE_MSG) {
+                filemsg* fmsg = (filemsg*) msg_buffer;
+                chan->cwrite(msg_buffer, sizes[i]);
+                int nbytes = read_response(chan, file_buffer, fmsg->length);
+                int64_t replied_ns = (trace || pool) ? LatencyTracer::now() : 0;
+                file->write(fmsg->offset, file_buffer, nbytes);
+                if (pool) {
+                    pool->record(replied_ns - sent_ns);
+                }
+                if (trace) {
+                    trace->record(FILE_MSG, TraceShard::QUEUE_STAGE, pushed_ns, sent_ns);
+                    trace->record(FILE_MSG, TraceShard::CHANNEL_STAGE, sent_ns, replied_ns);
+                    trace->record(FILE_MSG, TraceShard::END_TO_END_STAGE, pushed_ns, LatencyTracer::now());
+                }
+                continue;
+            } else if (*msg_type == QUIT_MSG) {
+                request_buffer.push(msg_buffer, sizeof(MESSAGE_TYPE));
+                done = true;
+                break;
+            }
+            if (pool) {
+                pool->record(LatencyTracer::now() - sent_ns);
+            }
+            if (trace) {
+                trace->record(*msg_type, TraceShard::QUEUE_STAGE, pushed_ns, sent_ns);
+                trace->record(*msg_type, TraceShard::CHANNEL_STAGE, sent_ns, LatencyTracer::now());
+            }
+        }
+
+        if (nresponses > 0) {
+            response_buffer.push_n((char*) responses.data(), sizeof(response_t), response_sizes.data(), nresponses);
+        }
+    }
+
+    delete[] file_buffer;
+}
+
+// reassembles reply frames (seqmsg header + reply) from a channel that may merge or split them
+class FrameReader {
+private:
+    RequestChannel* chan;
+    vector<char> buf;
+    int end;        // bytes held in buf
+    int consumed;   // length of the frame handed out by the previous call
+
+public:
+    FrameReader (RequestChannel* _chan, int _capacity) : chan(_chan), buf(2 * _capacity), end(0), consumed(0) {}
+
+    // reads the next complete frame into hdr and returns a pointer to its reply bytes,
+    // valid until the following call; nullptr if the channel fails
+    char* next (seqmsg& hdr) {
+        if (consumed > 0) {
+            memmove(buf.data(), buf.data() + consumed, end - consumed);
+            end -= consumed;
+            consumed = 0;
+        }
+        while (true) {
+            if (end >= (int) sizeof(seqmsg)) {
+                memcpy(&hdr, buf.data(), sizeof(seqmsg));
+                if (end >= (int) sizeof(seqmsg) + hdr.length) {
+                    break;
+                }
+            }
+            int nbytes = chan->cread(buf.data() + end, buf.size() - end);
+            if (nbytes <= 0) {
+                return nullptr;
+            }
+            end += nbytes;
+        }
+        consumed = sizeof(seqmsg) + hdr.length;
+        return buf.data() + sizeof(seqmsg);
+    }
+};
+
+void pipelined_worker_thread_function (RequestScheduler& request_buffer, BoundedBuffer& response_buffer, int id, RequestChannel* chan, ReceivedFile* file, LatencyTracer* tracer, WorkerPool* pool, int m, int k, int window) {
+    // functionality of the worker threads when requests are pipelined
+
+    // same as worker_thread_function, but up to window requests are outstanding on chan:
+    //      - every request is sent with a seqmsg header whose seqno is a free slot in the window
+    //      - replies come back framed with the same seqno, in any order, and are matched
+    //        to the request saved in that slot
+    //      - the worker only blocks on request_buffer when nothing is outstanding
+    //      - in adaptive mode, it only parks when nothing is outstanding either
+    int slot_size = sizeof(seqmsg) + m;
+    vector<char> inflight(window * slot_size);  // framed request saved per slot
+    vector<int64_t> pushed_ns(window), sent_ns(window);  // trace times per slot
+    vector<int> free_slots;
+    for (int i = window - 1; i >= 0; i--) {
+        free_slots.push_back(i);
+    }
+
+    vector<char> requests(k * m);
+    vector<int> sizes(k);
+    int max_points = max(1, m / (int) sizeof(double));
+    vector<response_t> responses(max_points);
+    vector<int> response_sizes(max_points, response_size(tracer));
+    TraceShard* trace = tracer ? tracer->new_shard() : nullptr;
+    FrameReader reader(chan, sizeof(seqmsg) + (file ? max(m, file->max_chunk()) : m));
+
+    bool done = false;
     while (true) {
-        char msg_buffer[MAX_MESSAGE];
-        request_buffer.pop(msg_buffer, sizeof(char));
-        MESSAGE_TYPE* msg_type = (MESSAGE_TYPE*)msg_buffer;
-
-        if (*msg_type == DATA_MSG) {
-            chan->cwrite(msg_buffer, sizeof(datamsg));
-            chan->cread(msg_buffer, MAX_MESSAGE);
-            response_buffer.push(msg_buffer, sizeof(datamsg));
-        } else if (*msg_type == FILE_MSG) {
-            filemsg* fmsg = (filemsg*)msg_buffer;
-            chan->cwrite(msg_buffer, sizeof(filemsg) + fmsg->length);
-            chan->cread(msg_buffer, MAX_MESSAGE);
-            response_buffer.push(msg_buffer, sizeof(filemsg) + fmsg->length);
-        } else if (*msg_type == QUIT_MSG) {
+        if (pool && !done && free_slots.size() == (size_t) window) {
+            pool->wait_turn(id);
+        }
+        // fill the window with whatever requests are available
+        while (!done && !free_slots.empty()) {
+            int want = min((int) free_slots.size(), k);
+            int count;
+            if (free_slots.size() == (size_t) window) {
+                count = request_buffer.pop_n(id, requests.data(), m, sizes.data(), want);
+            }
+            else {
+                count = request_buffer.try_pop_n(id, requests.data(), m, sizes.data(), want);
+            }
+            if (count == 0) {
+                break;
+            }
+
+            for (int i = 0; i < count; i++) {
+                char* msg_buffer = requests.data() + i * m;
+                int64_t pushed = pop_request(msg_buffer, sizes[i], tracer);
+                if (*((MESSAGE_TYPE*) msg_buffer) == QUIT_MSG) {
+                    request_buffer.push(msg_buffer, sizeof(MESSAGE_TYPE));
+                    done = true;
+                    break;
+                }
+
+                int seqno = free_slots.back();
+                free_slots.pop_back();
+                char* frame = inflight.data() + seqno * slot_size;
+                seqmsg hdr(seqno, sizes[i]);
+                memcpy(frame, &hdr, sizeof(seqmsg));
+                memcpy(frame + sizeof(seqmsg), msg_buffer, sizes[i]);
+                pushed_ns[seqno] = pushed;
+                sent_ns[seqno] = (trace || pool) ? LatencyTracer::now() : 0;
+                chan->cwrite(frame, sizeof(seqmsg) + sizes[i]);
+            }
+        }
+
+        if (free_slots.size() == (size_t) window) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+
+        // collect one reply and match it to its request
+        seqmsg hdr(0, 0);
+        char* reply = reader.next(hdr);
+        if (!reply) {
             break;
         }
-    }
+        char* request = inflight.data() + hdr.seqno * slot_size + sizeof(seqmsg);
+        MESSAGE_TYPE mtype;
+        memcpy(&mtype, request, sizeof(MESSAGE_TYPE));
+        int64_t pushed = pushed_ns[hdr.seqno];
+        if (pool) {
+            pool->record(LatencyTracer::now() - sent_ns[hdr.seqno]);
+        }
+        if (trace) {
+            trace->record(mtype, TraceShard::QUEUE_STAGE, pushed, sent_ns[hdr.seqno]);
+            trace->record(mtype, TraceShard::CHANNEL_STAGE, sent_ns[hdr.seqno], LatencyTracer::now());
+        }
 
+        int nresponses = 0;
+        if (mtype == DATA_MSG) {
+            datamsg dmsg(0, 0, 0);
+            memcpy(&dmsg, request, sizeof(datamsg));
+            double value;
+            memcpy(&value, reply, sizeof(double));
+            responses[nresponses++] = {dmsg.person, value, pushed, DATA_MSG};
+        } else if (mtype == DATA_RANGE_MSG) {
+            datarangemsg rmsg(0, 0, 0, 0);
+            memcpy(&rmsg, request, sizeof(datarangemsg));
+            int npoints = hdr.length / sizeof(double);
+            for (int j = 0; j < npoints; j++) {
+                double value;
+                memcpy(&value, reply + j * sizeof(double), sizeof(double));
+                responses[nresponses++] = {rmsg.person, value, pushed, DATA_RANGE_MSG};
+            }
+        } else if (mtype == FILE_MSG) {
+            filemsg fmsg(0, 0);
+            memcpy(&fmsg, request, sizeof(filemsg));
+            file->write(fmsg.offset, reply, hdr.length);
+            if (trace) {
+                trace->record(FILE_MSG, TraceShard::END_TO_END_STAGE, pushed, LatencyTracer::now());
+            }
+        }
+        if (nresponses > 0) {
+            response_buffer.push_n((char*) responses.data(), sizeof(response_t), response_sizes.data(), nresponses);
+        }
+        free_slots.push_back(hdr.seqno);
+    }
 }
 
-void histogram_thread_function (BoundedBuffer& response_buffer, HistogramCollection& hc) {
+void histogram_thread_function (BoundedBuffer& response_buffer, HistogramCollection& hc, LatencyTracer* tracer, int k) {
     // functionality of the histogram threads
 
     // forever loop
-    // pop response from the response_buffer
-    // call HC::update(resp->p_no, resp->double)
+    // pop up to k responses from the response_buffer
+    // group the values by resp->p_no and count each group in this thread's shard of the
+    // collection, without locking
+    // a response of any other size is the quit message: put it back for the next thread and exit
+    // when tracing, record each response's end-to-end time as it is consumed
+    vector<response_t> responses(k);
+    vector<int> sizes(k);
+    vector<vector<double>> values;
+    HistogramShard* shard = hc.new_shard();
+    TraceShard* trace = tracer ? tracer->new_shard() : nullptr;
+
+    bool done = false;
+    while (!done) {
+        int count = response_buffer.pop_n((char*) responses.data(), sizeof(response_t), sizes.data(), k);
+        int64_t consumed_ns = trace ? LatencyTracer::now() : 0;
+        for (int i = 0; i < count; i++) {
+            if (sizes[i] != response_size(tracer)) {
+                response_buffer.push((char*) &responses[i], sizes[i]);
+                done = true;
+                break;
+            }
+            int pno = responses[i].person;
+            if ((int) values.size() < pno) {
+                values.resize(pno);
+            }
+            values[pno-1].push_back(responses[i].value);
+            if (trace) {
+                trace->record(responses[i].mtype, TraceShard::END_TO_END_STAGE, responses[i].pushed_ns, consumed_ns);
+            }
+        }
+        for (size_t p = 0; p < values.size(); p++) {
+            if (!values[p].empty()) {
+                shard->update_batch(p+1, values[p].data(), values[p].size());
+                values[p].clear();
+            }
+        }
+    }
+}
 
-    while (true) {
-        char msg_buffer[MAX_MESSAGE];
-        response_buffer.pop(msg_buffer, sizeof(char));
-        datamsg* dmsg = (datamsg*)msg_buffer;
-        hc.update(dmsg->person, *(double*)(msg_buffer + sizeof(datamsg)));
+int pool_controller_function (WorkerPool& pool, RequestScheduler& request_buffer, const function<void()>& start_worker, int started, int lo, int hi) {
+    // functionality of the adaptive pool's controller
+
+    // every ADAPT_INTERVAL_MS until the pool is stopped:
+    //      - sample the replies and round-trip times the workers recorded, and request_buffer's depth;
+    //        requests back up when it is at least half full
+    //      - busy = throughput * round trip, the workers that had a request out on average (Little's law)
+    //      - grow by half when requests back up while nearly all active workers are busy,
+    //        starting workers on new channels (NEWCHANNEL_MSG) once the parked ones are used up
+    //      - stop growing for good once a step did not raise the throughput by 5%
+    //      - shrink to the busy workers plus headroom when nothing backs up and half are idle
+    // returns the number of active workers when it was stopped
+    int ceiling = hi;
+    bool grew = false;
+    double last_tput = 0;
+    long last_replies = pool.replies();
+    int64_t last_rtt = pool.rtt();
+    auto last = chrono::steady_clock::now();
+
+    while (!pool.wait_stop(ADAPT_INTERVAL_MS)) {
+        auto now = chrono::steady_clock::now();
+        long replies = pool.replies();
+        int64_t rtt = pool.rtt();
+        long dreplies = replies - last_replies;
+        if (dreplies == 0) {
+            continue;
+        }
+        double tput = dreplies / chrono::duration<double>(now - last).count();
+        double busy = tput * ((rtt - last_rtt) / 1e9 / dreplies);
+        last_replies = replies;
+        last_rtt = rtt;
+        last = now;
+
+        int active = pool.active();
+        if (grew && tput < 1.05 * last_tput) {
+            ceiling = active;
+        }
+        int target = active;
+        bool backlog = request_buffer.depth() >= max(1, request_buffer.capacity() / 2);
+        if (backlog && busy >= 0.75 * active) {
+            target = min(ceiling, active + max(1, active / 2));
+        }
+        else if (!backlog && busy < 0.5 * active) {
+            target = max(lo, (int) ceil(busy / 0.75));
+        }
+        grew = target > active;
+        last_tput = tput;
+
+        for (; started < target; started++) {
+            start_worker();
+        }
+        // producers move over before workers park, and workers wake before producers reach them
+        if (target < active) {
+            request_buffer.set_active(target);
+            pool.set_active(target);
+        }
+        else if (target > active) {
+            pool.set_active(target);
+            request_buffer.set_active(target);
+        }
     }
+    return pool.active();
 }
 
 
@@ -115,10 +683,23 @@ int main (int argc, char* argv[]) {
     int b = 20;		// default capacity of the request buffer (should be changed)
 	int m = MAX_MESSAGE;	// default capacity of the message buffer
 	string f = "";	// name of file to be transferred
+	BoundedBuffer::Backend backend = BoundedBuffer::QUEUE_BACKEND;	// backend of the request/response buffers
+	int k = 1;		// default number of messages moved per buffer operation
+	char ipc = 'f';	// transport of the channels: 'f' FIFO, 's' shared memory, 'q' message queue
+	bool r = false;	// request data points in ranges (DATA_RANGE_MSG) instead of one at a time
+	int o = 1;		// default number of outstanding requests per channel
+	string e = "";	// event threads of the server (-e of the server), empty for a thread per channel
+	int c = 0;		// largest file chunk to negotiate (the server grants at most MAX_CHUNK), 0 to always send m-byte chunks
+	int l = 0;		// significant digits of the percentiles printed below the histograms (at most 3), 0 for none
+	bool t = false;	// trace the latency of every request
+	bool d = false;	// attach to a running daemon server (./server -d) instead of forking one
+	RequestScheduler::Mode s = RequestScheduler::SHARED_MODE;	// one shared request buffer, or a deque per worker with stealing
+	int a = 0;		// most workers the adaptive pool may grow to from w, 0 (or at most w) for a fixed pool
+	string x = "";	// CPUs of the producer ('p'), worker ('w') and histogram ('h') threads, and of the server's channel ('c') and event ('e') threads, see ThreadPlacement.h
     
     // read arguments
     int opt;
-	while ((opt = getopt(argc, argv, "n:p:w:h:b:m:f:")) != -1) {
+	while ((opt = getopt(argc, argv, "n:p:w:h:b:m:f:q:k:i:ro:e:c:l:tds:a:x:")) != -1) {
 		switch (opt) {
 			case 'n':
 				n = atoi(optarg);
@@ -141,21 +722,106 @@ int main (int argc, char* argv[]) {
 			case 'f':
 				f = optarg;
                 break;
+			case 'q':
+				if (string(optarg) == "ring") {
+					backend = BoundedBuffer::RING_BACKEND;
+				}
+				else if (string(optarg) == "pool") {
+					backend = BoundedBuffer::POOL_BACKEND;
+				}
+				else {
+					backend = BoundedBuffer::QUEUE_BACKEND;
+				}
+				break;
+			case 'k':
+				k = max(1, atoi(optarg));
+				break;
+			case 'i':
+				ipc = optarg[0];
+				break;
+			case 'r':
+				r = true;
+				break;
+			case 'o':
+				o = min(max(1, atoi(optarg)), MAX_PIPELINE);
+				break;
+			case 'e':
+				e = optarg;
+				break;
+			case 'c':
+				c = max(0, atoi(optarg));
+				break;
+			case 'l':
+				// the percentiles print with 2 decimals, more digits would only cost memory
+				l = min(max(0, atoi(optarg)), 3);
+				break;
+			case 't':
+				t = true;
+				break;
+			case 'd':
+				d = true;
+				break;
+			case 's':
+				s = (string(optarg) == "steal") ? RequestScheduler::STEAL_MODE : RequestScheduler::SHARED_MODE;
+				break;
+			case 'a':
+				a = max(0, atoi(optarg));
+				break;
+			case 'x':
+				x = optarg;
+				break;
 		}
 	}
     
-	// fork and exec the server
-    int pid = fork();
-    if (pid == 0) {
-        execl("./server", "./server", "-m", (char*) to_string(m).c_str(), nullptr);
+	// c and e only place threads of the server, which gets them with its half of the spec
+	ThreadPlacement placement(x, "pwhce");
+	string server_x = ThreadPlacement::select(x, "ce");
+	if (d && server_x.find('=') != string::npos) {
+		cerr << "-x c=/e= only place threads of a forked server, start the daemon with them instead" << endl;
+	}
+
+	// fork and exec the server, or attach to a daemon with a control channel of our own
+    string control_name = "control";
+    if (d) {
+        control_name = "control" + to_string(getpid()) + "_";
+        string fifo = daemon_fifo_name(ipc, m);
+        int fd = open(fifo.c_str(), O_WRONLY | O_NONBLOCK);
+        if (fd < 0) {
+            cerr << "No daemon server for -i " << ipc << " -m " << m << " (start one with ./server -d -i " << ipc << " -m " << m << ")" << endl;
+            exit(1);
+        }
+        attachmsg attach(control_name);
+        if (write(fd, &attach, sizeof(attachmsg)) != sizeof(attachmsg)) {
+            EXITONERROR("attach " + fifo);
+        }
+        close(fd);
+    }
+    else if (fork() == 0) {
+        vector<string> args = {"./server", "-m", to_string(m), "-i", string(1, ipc)};
+        if (e != "") {
+            args.insert(args.end(), {"-e", e});
+        }
+        // the server places its half of every channel by the same layout, and its own classes
+        if (server_x != "") {
+            args.insert(args.end(), {"-x", server_x});
+        }
+        vector<char*> argv_server;
+        for (auto& arg : args) {
+            argv_server.push_back((char*) arg.c_str());
+        }
+        argv_server.push_back(nullptr);
+        execv("./server", argv_server.data());
     }
 
     //this_thread::sleep_for(chrono::seconds(2));
     
 	// initialize overhead (including the control channel)
-	FIFORequestChannel* chan = new FIFORequestChannel("control", FIFORequestChannel::CLIENT_SIDE);
-    BoundedBuffer request_buffer(b);
-    BoundedBuffer response_buffer(b);
+	RequestChannel* chan = create_channel(ipc, control_name, RequestChannel::CLIENT_SIDE, sizeof(seqmsg) + m);
+    // pool slots are sized by the message capacity, the largest message either buffer carries
+    // an adaptive pool gets a deque for every worker it may grow to, only w of them active at first
+    RequestScheduler request_buffer(s, max(w, a), b, backend, m);
+    request_buffer.set_active(w);
+    BoundedBuffer response_buffer(b, backend, m);
 	HistogramCollection hc;
 
     // array of producer threads (if data, p elements; if file, 1 element)
@@ -163,15 +829,23 @@ int main (int argc, char* argv[]) {
     // array of worker threads (w elements)
     // array of histogram threads (if data, h elements; if files, zero elements)
     vector<thread> producerThreads;
-    vector<FIFORequestChannel*> channels;
+    vector<RequestChannel*> channels;
     vector<thread> workerThreads;
     vector<thread> histogramThreads;
+    unique_ptr<ReceivedFile> file;  // output of a file transfer
+    unique_ptr<LatencyTracer> tracer(t ? new LatencyTracer() : nullptr);
+    unique_ptr<WorkerPool> pool(a > w ? new WorkerPool(w) : nullptr);  // adaptive worker pool
+    mutex control_lock;  // the controller asks for channels on chan while the run goes on
 
     // making histograms and adding to collection
     for (int i = 0; i < p; i++) {
         Histogram* h = new Histogram(10, -2.0, 2.0);
         hc.add(h);
     }
+    if (l > 0) {
+        // ECG values have 3 decimals (mV); anything beyond +-100 mV is counted as 100
+        hc.track_percentiles(0.001, 100.0, l);
+    }
 	
 	// record start time
     struct timeval start, end;
@@ -189,27 +863,84 @@ int main (int argc, char* argv[]) {
     //      - create w workers_threads (store worker array)
     //          -> create channel (store FIFO array)
     
-    int file_size = get_file_size(f.c_str()); 
     if (f == "") {
         for (int i = 0; i < p; i++) {
-
-            producerThreads.push_back(thread(patient_thread_function, ref(request_buffer), n, i + 1));
+            if (r) {
+                producerThreads.push_back(thread(patient_range_thread_function, ref(request_buffer), tracer.get(), n, i + 1, m, k));
+            }
+            else {
+                producerThreads.push_back(thread(patient_thread_function, ref(request_buffer), tracer.get(), n, i + 1, k));
+            }
+            placement.pin_class(producerThreads.back(), 'p', i);
+        }
+    }
+    else {
+        // ask the server for the file size: a filemsg with offset and length 0
+        int len = sizeof(filemsg) + f.size() + 1;
+        char* buf = new char[len];
+        filemsg fm(0, 0);
+        memcpy(buf, &fm, sizeof(filemsg));
+        strcpy(buf + sizeof(filemsg), f.c_str());
+        chan->cwrite(buf, len);
+        __int64_t file_size;
+        chan->cread(&file_size, sizeof(__int64_t));
+        delete[] buf;
+
+        // agree on the largest chunk before the data channels are created, they are sized for it;
+        // the file thread never sends more than file_size / w per chunk, so asking for more only wastes memory
+        int max_chunk = m;
+        int wanted = (int) min((__int64_t) c, file_size / max(w, 1));
+        if (wanted > m) {
+            chunkmsg cm(wanted);
+            chan->cwrite(&cm, sizeof(chunkmsg));
+            chan->cread(&max_chunk, sizeof(int));
         }
 
-        for (int i = 0; i < w; i++) {
-            channels.push_back(new FIFORequestChannel("control", FIFORequestChannel::CLIENT_SIDE));
-            workerThreads.push_back(thread(worker_thread_function, ref(request_buffer), ref(response_buffer), channels[i]));
+        file.reset(new ReceivedFile("received/" + f, file_size, m, max_chunk));
+        producerThreads.push_back(thread(file_thread_function, ref(request_buffer), tracer.get(), f, ref(*file), m, w, k));
+        placement.pin_class(producerThreads.back(), 'p', 0);
+    }
+
+    // every worker gets its own data channel, created by the server on NEWCHANNEL_MSG
+    auto start_worker = [&] () {
+        int i = channels.size();
+        MESSAGE_TYPE nc = NEWCHANNEL_MSG;
+        char name[MAX_MESSAGE];
+        {
+            lock_guard<mutex> lock(control_lock);
+            chan->cwrite(&nc, sizeof(MESSAGE_TYPE));
+            chan->cread(name, MAX_MESSAGE);
+        }
+        channels.push_back(create_channel(ipc, name, RequestChannel::CLIENT_SIDE, sizeof(seqmsg) + (file ? max(m, file->max_chunk()) : m)));
+        if (o > 1) {
+            workerThreads.push_back(thread(pipelined_worker_thread_function, ref(request_buffer), ref(response_buffer), i, channels[i], file.get(), tracer.get(), pool.get(), m, k, o));
+        }
+        else {
+            workerThreads.push_back(thread(worker_thread_function, ref(request_buffer), ref(response_buffer), i, channels[i], file.get(), tracer.get(), pool.get(), m, k));
         }
+        // the server named the channel "data<number>_"; the automatic layout pairs the worker with its thread by that number
+        if (!placement.pin_channel(workerThreads.back(), atoi(name + 4), false)) {
+            placement.pin_class(workerThreads.back(), 'w', i);
+        }
+    };
+    for (int i = 0; i < w; i++) {
+        start_worker();
+    }
 
-        for (int i = 0; i < h; i++) {
-            histogramThreads.push_back(thread(histogram_thread_function, ref(response_buffer), ref(hc)));        }
+    // the controller starts more workers as it needs them; channels and workerThreads are its
+    // until it is joined
+    int settled = w;
+    thread controller;
+    if (pool) {
+        controller = thread([&] {
+            settled = pool_controller_function(*pool, request_buffer, start_worker, w, w, a);
+        });
     }
-    else {
-        producerThreads.push_back(thread(file_thread_function, ref(request_buffer), f, file_size));
 
-        for (int i = 0; i < w; i++) {
-            channels.push_back(new FIFORequestChannel("control", FIFORequestChannel::CLIENT_SIDE));
-            workerThreads.push_back(thread(worker_thread_function, ref(request_buffer), ref(response_buffer), channels[i]));
+    if (f == "") {
+        for (int i = 0; i < h; i++) {
+            histogramThreads.push_back(thread(histogram_thread_function, ref(response_buffer), ref(hc), tracer.get(), k));
+            placement.pin_class(histogramThreads.back(), 'h', i);
         }
     }
 
@@ -228,13 +959,24 @@ int main (int argc, char* argv[]) {
 	/* join all threads here */
     // iterate over all thread arrays, calling join
     //      - order is very important; producers before consumers
+    //      - a single QUIT_MSG is passed along from thread to thread once its producers are done
+    MESSAGE_TYPE q = QUIT_MSG;
     for (auto& thread : producerThreads) {
         thread.join();
     }
+    if (pool) {
+        // every started worker has to see the QUIT_MSG, parked or not
+        pool->stop();
+        controller.join();
+        request_buffer.set_active(workerThreads.size());
+        pool->set_active(workerThreads.size());
+    }
+    request_buffer.push((char*) &q, sizeof(MESSAGE_TYPE));
 
     for (auto& thread : workerThreads) {
         thread.join();
     }
+    response_buffer.push((char*) &q, sizeof(MESSAGE_TYPE));
 
     for (auto& thread : histogramThreads) {
         thread.join();
@@ -247,18 +989,35 @@ int main (int argc, char* argv[]) {
 	if (f == "") {
 		hc.print();
 	}
+	else if (file->missing() > 0) {
+		cerr << file->missing() << " chunks of " << f << " were not received" << endl;
+	}
     int secs = ((1e6*end.tv_sec - 1e6*start.tv_sec) + (end.tv_usec - start.tv_usec)) / ((int) 1e6);
     int usecs = (int) ((1e6*end.tv_sec - 1e6*start.tv_sec) + (end.tv_usec - start.tv_usec)) % ((int) 1e6);
     cout << "Took " << secs << " seconds and " << usecs << " micro seconds" << endl;
+    if (s == RequestScheduler::STEAL_MODE) {
+        cout << "Workers stole " << request_buffer.stolen() << " of " << request_buffer.pushed() << " requests" << endl;
+    }
+    if (pool) {
+        cout << "Adaptive pool settled at " << settled << " workers (" << channels.size() << " channels opened, at most " << a << ")" << endl;
+    }
+    if (tracer) {
+        tracer->print();
+    }
 
     // quit and close all channels in FIFO array
+    for (auto channel : channels) {
+        channel->cwrite((char*) &q, sizeof(MESSAGE_TYPE));
+        delete channel;
+    }
 
 	// quit and close control channel
-    MESSAGE_TYPE q = QUIT_MSG;
     chan->cwrite ((char *) &q, sizeof (MESSAGE_TYPE));
     cout << "All Done!" << endl;
     delete chan;
 
-	// wait for server to exit
-	wait(nullptr);
+	// wait for server to exit; a daemon keeps running
+	if (!d) {
+		wait(nullptr);
+	}
 }
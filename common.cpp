@@ -2,6 +2,10 @@
 
 using namespace std;
 
+// exact powers of ten for the fast path of parse_double
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
 
 void EXITONERROR (string msg) {
     perror(msg.c_str());
@@ -25,6 +29,13 @@ vector<string> split (string line, char separator) {
 	return result;
 }
 
+/* A daemon only serves clients using its own transport and message capacity, so both are
+ part of the name it listens on; a client with other settings finds no daemon instead of
+ creating channels the daemon cannot match. */
+string daemon_fifo_name (char ipc, int capacity) {
+    return "fifo_daemon_" + string(1, ipc) + "_" + to_string(capacity);
+}
+
 __int64_t get_file_size (string filename) {
     struct stat buf;
     int fd = open(filename.c_str(), O_RDONLY);
@@ -34,3 +45,46 @@ __int64_t get_file_size (string filename) {
     return size;
 }
 
+
+/* Parses a decimal number starting at p without allocating and advances p past it.
+ Plain "[-]ddd.ddd" numbers with at most 15 significant digits are converted as an exact
+ integer divided by an exact power of ten, which is correctly rounded and therefore
+ identical to strtod; anything else (exponents, long mantissas) falls back to strtod. */
+double parse_double (const char*& p, const char* end) {
+    const char* begin = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int ndigits = 0;
+    int nfraction = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10 + (*p++ - '0');
+        ndigits += (mantissa != 0);
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            ndigits += (mantissa != 0);
+            nfraction++;
+        }
+    }
+
+    if (ndigits <= 15 && nfraction <= 22 && !(p < end && (*p == 'e' || *p == 'E'))) {
+        double value = (double) mantissa / POW10[nfraction];
+        return negative ? -value : value;
+    }
+
+    char tmp[64];
+    size_t len = min((size_t) (end - begin), sizeof(tmp) - 1);
+    memcpy(tmp, begin, len);
+    tmp[len] = 0;
+    char* stop;
+    double value = strtod(tmp, &stop);
+    p = begin + (stop - tmp);
+    return value;
+}
@@ -18,12 +18,14 @@
 
 #define NUM_PERSONS 15  // number of person to collect data for
 #define MAX_MESSAGE 256 // maximum buffer size for each message
+#define MAX_PIPELINE 64 // maximum number of outstanding requests on one channel
+#define MAX_CHUNK (4 << 20) // largest file chunk a client can negotiate with CHUNK_MSG
 
 typedef char byte_t;
 
 
 // different types of messages
-enum MESSAGE_TYPE {UNKNOWN_MSG, DATA_MSG, FILE_MSG, NEWCHANNEL_MSG, QUIT_MSG};
+enum MESSAGE_TYPE {UNKNOWN_MSG, DATA_MSG, FILE_MSG, NEWCHANNEL_MSG, QUIT_MSG, DATA_RANGE_MSG, SEQ_MSG, CHUNK_MSG};
 
 
 // message requesting a data point
@@ -43,6 +45,73 @@ public:
 };
 
 
+// message requesting count consecutive data points starting at seconds
+// the reply is count packed doubles; count * sizeof(double) must fit the server's buffer
+class datarangemsg {
+public:
+    MESSAGE_TYPE mtype;
+    int person;
+    double seconds;
+    int ecgno;
+    int count;
+
+    datarangemsg (int _person, double _seconds, int _eno, int _count) {
+        mtype = DATA_RANGE_MSG;
+        person = _person;
+        seconds = _seconds;
+        ecgno = _eno;
+        count = _count;
+    }
+};
+
+
+// header of a pipelined request or of its reply
+// the request (or reply) of length bytes follows the header; seqno matches a reply to its request
+class seqmsg {
+public:
+    MESSAGE_TYPE mtype;
+    int seqno;
+    int length;
+
+    seqmsg (int _seqno, int _length) {
+        mtype = SEQ_MSG;
+        seqno = _seqno;
+        length = _length;
+    }
+};
+
+
+// message negotiating the largest file chunk, sent on the control channel before the data channels exist
+// the reply is the granted length as an int: at least the server's buffer capacity, at most length (or the
+// transport's limit); data channels created afterwards carry chunks of that size
+class chunkmsg {
+public:
+    MESSAGE_TYPE mtype;
+    int length;
+
+    chunkmsg (int _length) {
+        mtype = CHUNK_MSG;
+        length = _length;
+    }
+};
+
+
+// record a client writes to a daemon server's well-known FIFO (see daemon_fifo_name) to attach;
+// the daemon then serves a control channel called name. It is smaller than PIPE_BUF, so the
+// write is atomic and clients attaching at the same time need no lock
+class attachmsg {
+public:
+    MESSAGE_TYPE mtype;
+    char name[64];
+
+    attachmsg (const std::string& _name) {
+        mtype = NEWCHANNEL_MSG;
+        memset(name, 0, sizeof(name));
+        strncpy(name, _name.c_str(), sizeof(name) - 1);
+    }
+};
+
+
 // message requesting a file
 class filemsg {
 public:
@@ -60,5 +129,7 @@ public:
 void EXITONERROR (std::string msg);
 std::vector<std::string> split (std::string line, char separator);
 __int64_t get_file_size (std::string filename);
+std::string daemon_fifo_name (char ipc, int capacity);
+double parse_double (const char*& p, const char* end);
 
 #endif
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <thread>
+#include "common.h"
+#include "Snapshot.h"
+
+using namespace std;
+
+
+/* Converts BIMDC/1.csv ... BIMDC/<NUM_PERSONS>.csv into one binary snapshot, which the
+ server maps at startup instead of parsing the CSVs.
+   ./mksnapshot [-o file]    writes the snapshot (default SNAPSHOT_FILE)
+   ./mksnapshot -v [-o file] checks an existing snapshot against its checksum
+ Rerun it after changing a CSV; the server ignores a snapshot older than any CSV. */
+
+int main (int argc, char* argv[]) {
+	string filename = SNAPSHOT_FILE;
+	bool verify = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:v")) != -1) {
+		switch (opt) {
+			case 'o':
+				filename = optarg;
+				break;
+			case 'v':
+				verify = true;
+				break;
+			default:
+				cerr << "usage: " << argv[0] << " [-o file] [-v]" << endl;
+				return 1;
+		}
+	}
+
+	if (verify) {
+		string error;
+		Snapshot* snapshot = Snapshot::open(filename, error);
+		if (!snapshot) {
+			cerr << error << endl;
+			return 1;
+		}
+		bool ok = snapshot->verify();
+		cout << filename << ": " << snapshot->persons() << " persons, checksum " << (ok ? "ok" : "MISMATCH") << endl;
+		delete snapshot;
+		return ok ? 0 : 1;
+	}
+
+	auto start = chrono::steady_clock::now();
+	vector<parsed_trace> traces(NUM_PERSONS);
+	int nloaders = min((int) max(thread::hardware_concurrency(), 1u), NUM_PERSONS);
+	vector<thread> loaders;
+	for (int t = 0; t < nloaders; t++) {
+		loaders.push_back(thread([t, nloaders, &traces] {
+			for (int i = t; i < NUM_PERSONS; i += nloaders) {
+				string csv = "BIMDC/" + to_string(i + 1) + ".csv";
+				if (!parse_csv_trace(csv, traces[i])) {
+					EXITONERROR("Data file: " + csv);
+				}
+			}
+		}));
+	}
+	for (auto& loader : loaders) {
+		loader.join();
+	}
+
+	if (!write_snapshot(filename, traces)) {
+		EXITONERROR(filename);
+	}
+	size_t rows = 0;
+	for (auto& t : traces) {
+		rows += t.time.size();
+	}
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	cout << "Wrote " << filename << ": " << NUM_PERSONS << " persons, " << rows << " rows in " << ms << " ms" << endl;
+}
@@ -20,6 +20,12 @@ checkclean () {
     fi
 }
 
+# function to compare the client output in out.tst with an expected data file
+# (the expected files have CRLF line endings, the client prints LF)
+checkdata () {
+    [ $(comm -12 <(tr -d '\r' < out.tst | sort) <(tr -d '\r' < "$1" | sort) | wc -l) -eq $(wc -l < "$1") ]
+}
+
 
 echo -e "To remove colour from tests, set COLOUR to 1 in sh file\n"
 COLOUR=0
@@ -67,6 +73,27 @@ else
     echo -e "  ${RED}Failed${NC}"
 fi
 
+echo -e "\nTesting :: ./test-files/tester < test-files/test_ring_synch.txt\n"
+if timeout 60 ./test-files/tester < test-files/test_ring_synch.txt >/dev/null 2>&1; then
+    echo -e "  ${GREEN}Test Ten Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+
+echo -e "\nTesting :: ./test-files/tester < test-files/test_pool_synch.txt\n"
+if timeout 60 ./test-files/tester < test-files/test_pool_synch.txt >/dev/null 2>&1; then
+    echo -e "  ${GREEN}Test Eleven Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+
+echo -e "\nTesting :: ./test-files/tester < test-files/test_batch_synch.txt\n"
+if timeout 60 ./test-files/tester < test-files/test_batch_synch.txt >/dev/null 2>&1; then
+    echo -e "  ${GREEN}Test Twelve Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+
 
 remake
 #echo -e "\nTest cases for datapoint transfers"
@@ -75,7 +102,7 @@ echo -e "\nTesting :: ./client -n 1000 -p 5 -w 100 -h 20 -b 5\n"
 N=1000
 P=5
 ./client -n ${N} -p ${P} -w 100 -h 20 -b 5 >out.tst
-if [ $(comm -12 <(sort out.tst) <(sort test-files/data1.txt) | wc -l) -eq $(cat test-files/data1.txt | wc -l) ]; then
+if checkdata test-files/data1.txt; then
     echo -e "  ${GREEN}Test Five Passed${NC}"
 else
     echo -e "  ${RED}Failed${NC}"
@@ -86,13 +113,125 @@ echo -e "\nTesting :: ./client -n 10000 -p 10 -w 100 -h 20 -b 30\n"
 N=10000
 P=10
 ./client -n ${N} -p ${P} -w 100 -h 20 -b 30 >out.tst
-if [ $(comm -12 <(sort out.tst) <(sort test-files/data2.txt) | wc -l) -eq $(cat test-files/data2.txt | wc -l) ]; then
+if checkdata test-files/data2.txt; then
     echo -e "  ${GREEN}Test Six Passed${NC}"
 else
     echo -e "  ${RED}Failed${NC}"
 fi
 checkclean "f"
 
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 100 -h 20 -b 5 -i s\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 100 -h 20 -b 5 -i s >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Thirteen Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 100 -h 20 -b 5 -i q\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 100 -h 20 -b 5 -i q >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Fourteen Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 10000 -p 10 -w 100 -h 20 -b 30 -r\n"
+N=10000
+P=10
+./client -n ${N} -p ${P} -w 100 -h 20 -b 30 -r >out.tst
+if checkdata test-files/data2.txt; then
+    echo -e "  ${GREEN}Test Fifteen Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 10 -h 20 -b 5 -o 8\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 10 -h 20 -b 5 -o 8 >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Sixteen Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./mksnapshot; ./client -n 1000 -p 5 -w 100 -h 20 -b 5\n"
+N=1000
+P=5
+./mksnapshot >/dev/null 2>&1
+./client -n ${N} -p ${P} -w 100 -h 20 -b 5 >out.tst 2>err.tst
+if grep -q "mapped" err.tst && checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Eighteen Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+rm -f BIMDC/snapshot.bin
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 100 -h 20 -b 5 -s steal\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 100 -h 20 -b 5 -s steal >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Nineteen Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 2 -a 100 -h 20 -b 20\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 2 -a 100 -h 20 -b 20 >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Twenty Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 100 -h 20 -b 5 -x auto\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 100 -h 20 -b 5 -x auto >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Twenty-One Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 100 -h 20 -b 5 -e 4\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 100 -h 20 -b 5 -e 4 >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Twenty-Four Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
+echo -e "\nTesting :: ./client -n 1000 -p 5 -w 100 -h 20 -b 5 -e 4 -o 8\n"
+N=1000
+P=5
+./client -n ${N} -p ${P} -w 100 -h 20 -b 5 -e 4 -o 8 >out.tst
+if checkdata test-files/data1.txt; then
+    echo -e "  ${GREEN}Test Twenty-Five Passed${NC}"
+else
+    echo -e "  ${RED}Failed${NC}"
+fi
+checkclean "f"
+
 
 remake
 #echo -e "\nTest cases for csv file transfers"
@@ -142,5 +281,55 @@ else
 fi
 checkclean "f"
 
+echo -e "\nTesting :: head -c 4M /dev/urandom >BIMDC/big.bin; ./client -w 20 -b 50 -c 65536 -f big.bin; diff -sqwB BIMDC/big.bin received/big.bin\n"
+head -c 4M /dev/urandom >BIMDC/big.bin
+./client -w 20 -b 50 -c 65536 -f big.bin >/dev/null 2>&1
+if test -f "received/big.bin"; then
+    if diff BIMDC/big.bin received/big.bin >/dev/null; then
+        echo -e "  ${GREEN}Test Twenty-Two Passed${NC}"
+    else
+        echo -e "  ${RED}Failed${NC}"
+    fi
+else
+    echo -e "  ${ORANGE}No big.bin in received/ directory${NC}"
+fi
+rm -f BIMDC/big.bin
+checkclean "f"
+
+echo -e "\nTesting :: head -c 4M /dev/urandom >BIMDC/big.bin; ./client -w 20 -b 50 -c 65536 -o 4 -f big.bin; diff -sqwB BIMDC/big.bin received/big.bin\n"
+head -c 4M /dev/urandom >BIMDC/big.bin
+./client -w 20 -b 50 -c 65536 -o 4 -f big.bin >/dev/null 2>&1
+if test -f "received/big.bin"; then
+    if diff BIMDC/big.bin received/big.bin >/dev/null; then
+        echo -e "  ${GREEN}Test Twenty-Three Passed${NC}"
+    else
+        echo -e "  ${RED}Failed${NC}"
+    fi
+else
+    echo -e "  ${ORANGE}No big.bin in received/ directory${NC}"
+fi
+rm -f BIMDC/big.bin
+checkclean "f"
+
+echo -e "\nTesting :: ./server -d; ./client -d -w 100 -b 30 -f 1.csv (twice); diff -sqwB BIMDC/1.csv received/1.csv\n"
+./server -d >/dev/null 2>&1 &
+DAEMON=$!
+sleep 1
+./client -d -w 100 -b 30 -f 1.csv >/dev/null 2>&1
+rm -f received/1.csv
+./client -d -w 100 -b 30 -f 1.csv >/dev/null 2>&1
+kill ${DAEMON}
+wait ${DAEMON} 2>/dev/null
+if test -f "received/1.csv"; then
+    if diff BIMDC/1.csv received/1.csv >/dev/null; then
+        echo -e "  ${GREEN}Test Seventeen Passed${NC}"
+    else
+        echo -e "  ${RED}Failed${NC}"
+    fi
+else
+    echo -e "  ${ORANGE}No 1.csv in received/ directory${NC}"
+fi
+checkclean "f"
+
 echo -e "\n"
 exit 0
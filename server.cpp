@@ -1,28 +1,88 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
 #include <thread>
-#include "FIFORequestChannel.h"
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include "BoundedBuffer.h"
+#include "FileCache.h"
+#include "RequestChannel.h"
+#include "Snapshot.h"
+#include "ThreadPlacement.h"
 
 using namespace std;
 
 
 int buffercapacity = MAX_MESSAGE;
+atomic<int> chunkcapacity(MAX_MESSAGE); // largest file chunk granted through CHUNK_MSG, never below buffercapacity
+/* chunk granted to the client whose control channel this thread serves, 0 if it has not
+negotiated; its data channels are sized for it */
+thread_local int session_chunk = 0;
+char ipcmethod = 'f'; // transport of the channels: 'f' FIFO, 's' shared memory, 'q' message queue
 char* buffer = NULL; // buffer used by the server, allocated in the main
 
-int nchannels = 0;
-vector<string> all_data[NUM_PERSONS];
+atomic<int> nchannels(0); // data channels created so far, across all clients of a daemon
 
+// well-known FIFO of the daemon mode, removed again when the daemon is stopped
+string daemon_fifo;
+
+// open BIMDC files shared by all channels, sized by -c
+FileCache* file_cache = nullptr;
+
+// CPUs of the channel threads ('c') and event threads ('e'), set by -x
+ThreadPlacement* placement = nullptr;
+
+// columns of every person, pointing into the snapshot mapping or into parsed_data
+ecg_trace all_data[NUM_PERSONS];
+// BIMDC snapshot mapped at startup, nullptr when the CSVs were parsed instead
+Snapshot* snapshot = nullptr;
+parsed_trace parsed_data[NUM_PERSONS];
+
+
+// epoll instance of the event-driven mode, -1 when every channel gets its own thread
+int epollfd = -1;
+// channels currently registered with epollfd, so shutdown can wait for their QUIT_MSGs
+int nepoll_channels = 0;
+mutex epoll_mutex;
+condition_variable epoll_drained;
+// fires when the earliest held reply of the event-driven mode is due, registered with epollfd
+int timerfd = -1;
 
 // pre-declared because function signature required call in process_newchannel_request
-void handle_process_loop (FIFORequestChannel* _channel);
+struct channel_state;
+channel_state* open_channel_state (RequestChannel* channel, bool evented = false);
+void handle_process_loop (RequestChannel* _channel);
 
-void process_newchannel_request (FIFORequestChannel* _channel) {
-	nchannels++;
-	string new_channel_name = "data" + to_string(nchannels) + "_";
+void process_newchannel_request (RequestChannel* _channel) {
+	int channel_no = ++nchannels;
+	string new_channel_name = "data" + to_string(channel_no) + "_";
 	char buf[30];
 	strcpy(buf, new_channel_name.c_str());
 	_channel->cwrite(buf, new_channel_name.size()+1);
 
-	FIFORequestChannel* data_channel = new FIFORequestChannel(new_channel_name, FIFORequestChannel::SERVER_SIDE);
+	RequestChannel* data_channel = create_channel(ipcmethod, new_channel_name, RequestChannel::SERVER_SIDE, sizeof(seqmsg) + max(buffercapacity, session_chunk));
+	if (epollfd >= 0 && data_channel->poll_fd() >= 0) {
+		// event-driven mode: the epoll pool serves the channel
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.ptr = open_channel_state(data_channel, true);
+		{
+			lock_guard<mutex> lock(epoll_mutex);
+			nepoll_channels++;
+		}
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, data_channel->poll_fd(), &ev) < 0) {
+			EXITONERROR("epoll_ctl");
+		}
+		return;
+	}
 	thread thread_for_client(handle_process_loop, data_channel);
+	if (!placement->pin_channel(thread_for_client, channel_no, true)) {
+		placement->pin_class(thread_for_client, 'c', channel_no - 1);
+	}
 	thread_for_client.detach();
 }
 
@@ -30,64 +90,82 @@ void process_newchannel_request (FIFORequestChannel* _channel) {
 void populate_file_data (int person) {
 	//cout << "populating for person " << person << endl;
 	string filename = "BIMDC/" + to_string(person) + ".csv";
-	char line[100];
-	ifstream ifs(filename.c_str());
-	if (ifs.fail()){
+	if (!parse_csv_trace(filename, parsed_data[person-1])) {
 		EXITONERROR("Data file: " + filename + " does not exist in the BIMDC/ directory");
 	}
-	
-	while (!ifs.eof()) {
-		line[0] = 0;
-		ifs.getline(line, 100);
-		if (ifs.eof()) {
-			break;
-		}
-		
-		if (line[0]) {
-			all_data[person-1].push_back(string(line));
+	all_data[person-1] = parsed_data[person-1].view();
+}
+
+/* Maps the snapshot written by mksnapshot and points all_data into it. Returns false, so
+the CSVs get parsed, if there is no usable snapshot or a CSV changed after it was written.
+Only the header and column bounds are checked, so startup does not grow with the dataset;
+"./mksnapshot -v" checks the whole file against its checksum. */
+bool map_snapshot () {
+	// a missing snapshot is the normal case, only a rejected one is worth mentioning
+	struct stat snap;
+	if (stat(SNAPSHOT_FILE, &snap) < 0) {
+		return false;
+	}
+	string error;
+	snapshot = Snapshot::open(SNAPSHOT_FILE, error);
+	if (snapshot && snapshot->persons() != NUM_PERSONS) {
+		error = string(SNAPSHOT_FILE) + " has " + to_string(snapshot->persons()) + " persons";
+	}
+	for (int i = 1; snapshot && error.empty() && i <= NUM_PERSONS; i++) {
+		struct stat csv;
+		string filename = "BIMDC/" + to_string(i) + ".csv";
+		if (stat(filename.c_str(), &csv) == 0 && (csv.st_mtim.tv_sec > snap.st_mtim.tv_sec
+			|| (csv.st_mtim.tv_sec == snap.st_mtim.tv_sec && csv.st_mtim.tv_nsec > snap.st_mtim.tv_nsec))) {
+			error = filename + " is newer than " + SNAPSHOT_FILE;
 		}
 	}
+	if (!error.empty()) {
+		cerr << "Ignoring snapshot: " << error << endl;
+		delete snapshot;
+		snapshot = nullptr;
+		return false;
+	}
+	for (int i = 1; i <= NUM_PERSONS; i++) {
+		all_data[i-1] = snapshot->trace(i);
+	}
+	return true;
 }
 
-double get_data_from_memory(int person, double seconds, int ecgno) {
-    std::cout << "DEBUG: get_data_from_memory - person: " << person << " seconds: " << seconds << " ecgno: " << ecgno << std::endl;
-
-    int index = (int)round(seconds / 0.004);
-
-    if (person < 1 || person > NUM_PERSONS) {
-        std::cerr << "ERROR: Invalid person number: " << person << std::endl;
-        return 0.0;  // Return a default value in case of an error
-    }
-
-    if (index < 0 || index >= all_data[person - 1].size()) {
-        std::cerr << "ERROR: Invalid index: " << index << std::endl;
-        return 0.0;  // Return a default value in case of an error
-    }
-
-    std::cout << "DEBUG: Inside valid range - index: " << index << std::endl;
-
-    std::string line = all_data[person - 1][index];
-    std::vector<std::string> parts = split(line, ',');
+double get_data_from_memory (int person, double seconds, int ecgno) {
+	if (person < 1 || person > NUM_PERSONS) {
+		cerr << "ERROR: Invalid person number: " << person << endl;
+		return 0.0;
+	}
 
-    double ecg1 = std::stod(parts[1]);
-    double ecg2 = std::stod(parts[2]);
+	const ecg_trace& trace = all_data[person-1];
+	int index = (int) round(seconds / 0.004);
+	if (index < 0 || index >= trace.nrows) {
+		cerr << "ERROR: Invalid index: " << index << endl;
+		return 0.0;
+	}
 
-    if (ecgno == 1) {
-        return ecg1;
-    } else {
-        return ecg2;
-    }
+	if (ecgno == 1) {
+		return trace.ecg1[index];
+	}
+	else {
+		return trace.ecg2[index];
+	}
 }
 
 
-void process_file_request (FIFORequestChannel* rc, char* request) {
+void process_file_request (RequestChannel* rc, char* request) {
 	filemsg f = *((filemsg*) request);
 	string filename = request + sizeof(filemsg);
 	filename = "BIMDC/" + filename; // adding the path prefix to the requested file name
 	//cout << "Server received request for file " << filename << endl;
 
+	FileCache::Entry* file = file_cache->acquire(filename);
+
 	if (f.offset == 0 && f.length == 0) { // means that the client is asking for file size
-		__int64_t fs = get_file_size (filename);
+		__int64_t fs = file ? file->size : 0;
+		if (file) {
+			file_cache->release(file);
+		}
 		rc->cwrite ((char*) &fs, sizeof(__int64_t));
 		return;
 	}
@@ -97,127 +175,633 @@ void process_file_request (FIFORequestChannel* rc, char* request) {
 	char* response = request; 
 
 	// make sure that client is not requesting too big a chunk
-	if (f.length > buffercapacity) {
+	if (f.length > chunkcapacity) {
 		cerr << "Client is requesting a chunk bigger than server's capacity" << endl;
 		cerr << "Returning nothing (i.e., 0 bytes) in response" << endl;
 		rc->cwrite(response, 0);
+		if (file) {
+			file_cache->release(file);
+		}
+		return;
 	}
 
-	FILE* fp = fopen(filename.c_str(), "rb");
-	if (!fp) {
+	if (!file) {
 		cerr << "Server received request for file: " << filename << " which cannot be opened" << endl;
-		rc->cwrite(buffer, 0);
+		rc->cwrite(response, 0);
 		return;
 	}
-	fseek(fp, f.offset, SEEK_SET);
-	int nbytes = fread(response, 1, f.length, fp);
+	/* the chunk goes from the file to the channel without a stdio buffer; on a pipe
+	it is spliced in the kernel, other transports copy it through response */
+	int nbytes = rc->cwrite_file(file->fd, f.offset, f.length, response);
 
 	/* making sure that the client is asking for the right # of bytes,
 	this is especially imp for the last chunk of a file when the 
 	remaining lenght is < buffercap of the client*/
 	assert(nbytes == f.length); 
 
-	rc->cwrite(response, nbytes);
-	fclose(fp);
+	file_cache->release(file);
 }
 
-void process_data_request (FIFORequestChannel* rc, char* request) {
-	std::cout << "process_data_request" << std::endl;
+void process_data_request (RequestChannel* rc, char* request) {
 	datamsg* d = (datamsg*) request;
-	std::cout << "person: " <<  d->person << " seconds: " << d->seconds << " ecgno: " << d->ecgno << std::endl;
 	double data = get_data_from_memory(d->person, d->seconds, d->ecgno);
 	rc->cwrite(&data, sizeof(double));
 }
 
-void process_unknown_request (FIFORequestChannel* rc) {
+void process_datarange_request (RequestChannel* rc, char* request) {
+	datarangemsg d = *((datarangemsg*) request);
+
+	// make sure that client is not requesting more points than fit in a response
+	// (compared as a count, so a huge count cannot overflow the size)
+	if (d.count <= 0 || d.count > buffercapacity / (int) sizeof(double)) {
+		cerr << "Client is requesting more data points than fit in the server's capacity" << endl;
+		cerr << "Returning nothing (i.e., 0 bytes) in response" << endl;
+		rc->cwrite(request, 0);
+		return;
+	}
+
+	/* request buffer can be used for response buffer, because everything necessary have
+	been copied over to datarangemsg d*/
+	double* response = (double*) request;
+	for (int i = 0; i < d.count; i++) {
+		response[i] = get_data_from_memory(d.person, d.seconds + i * 0.004, d.ecgno);
+	}
+	rc->cwrite(response, d.count * sizeof(double));
+}
+
+void process_unknown_request (RequestChannel* rc) {
 	char a = 0;
 	rc->cwrite(&a, sizeof(char));
 }
 
 
-void process_request (FIFORequestChannel* rc, char* _request) {
-	std::cout << "process_request" << std::endl;
-	datamsg* d = (datamsg*) _request;
-	std::cout << "person: " <<  d->person << " seconds: " << d->seconds << " ecgno: " << d->ecgno << std::endl;
+void process_chunk_request (RequestChannel* rc, char* request) {
+	chunkmsg c = *((chunkmsg*) request);
+	/* message queues are bounded by the per-user RLIMIT_MSGQUEUE, which a queue per
+	direction per worker exhausts quickly, so they keep the -m message size */
+	int limit = (ipcmethod == 'q') ? buffercapacity : MAX_CHUNK;
+	int granted = max(buffercapacity, min(c.length, limit));
+	session_chunk = granted;
+	// other clients of a daemon may have been granted more; requests are checked against the largest
+	int largest = chunkcapacity;
+	while (largest < granted && !chunkcapacity.compare_exchange_weak(largest, granted));
+	rc->cwrite(&granted, sizeof(int));
+}
+
+// bytes a request's response can take; file chunks may be larger than buffercapacity once negotiated
+int response_size (char* request) {
+	MESSAGE_TYPE m;
+	memcpy(&m, request, sizeof(MESSAGE_TYPE));
+	if (m == FILE_MSG) {
+		filemsg f(0, 0);
+		memcpy(&f, request, sizeof(filemsg));
+		return max(buffercapacity, min(f.length, (int) chunkcapacity));
+	}
+	return buffercapacity;
+}
+
+// simulated service time of a request in microseconds: looking up data takes up to 5 ms
+int service_delay (char* _request) {
+	MESSAGE_TYPE m = *((MESSAGE_TYPE*) _request);
+	if (m == DATA_MSG || m == DATA_RANGE_MSG) {
+		return rand() % 5000;
+	}
+	return 0;
+}
+
+// serves a request at once, without its simulated service time
+void dispatch_request (RequestChannel* rc, char* _request) {
 	MESSAGE_TYPE m = *((MESSAGE_TYPE*) _request);
 	if (m == DATA_MSG) {
-		usleep(rand() % 5000);
 		process_data_request(rc, _request);
 	}
+	else if (m == DATA_RANGE_MSG) {
+		process_datarange_request(rc, _request);
+	}
 	else if (m == FILE_MSG) {
 		process_file_request(rc, _request);
 	}
 	else if (m == NEWCHANNEL_MSG) {
 		process_newchannel_request(rc);
 	}
+	else if (m == CHUNK_MSG) {
+		process_chunk_request(rc, _request);
+	}
 	else {
 		process_unknown_request(rc);
 	}
 }
 
-void handle_process_loop (FIFORequestChannel* channel) {
+void process_request (RequestChannel* rc, char* _request) {
+	int delay = service_delay(_request);
+	if (delay > 0) {
+		usleep(delay);
+	}
+	dispatch_request(rc, _request);
+}
+
+/* Requests framed with a seqmsg header are pipelined: the client sends several before
+reading any reply. The channel thread hands each framed request to a pool of helper
+threads that grows on demand (up to MAX_PIPELINE), and each helper replies through a
+SeqReplyChannel, which frames the reply with the request's seqno. Channels served by
+the event threads have no helpers; see serve_evented. Replies may go out in any order. */
+class SeqReplyChannel : public RequestChannel {
+private:
+	RequestChannel* channel;
+	mutex* wlock;
+	vector<char> frame;
+
+public:
+	int seqno;
+
+	SeqReplyChannel (RequestChannel* _channel, mutex* _wlock) : RequestChannel(_channel->name(), SERVER_SIDE),
+		channel(_channel), wlock(_wlock), frame(sizeof(seqmsg) + buffercapacity), seqno(0) {}
+
+	int cread (void*, int) override {
+		return -1;
+	}
+
+	int cwrite (void* msgbuf, int msgsize) override {
+		if (frame.size() < sizeof(seqmsg) + msgsize) {
+			frame.resize(sizeof(seqmsg) + msgsize);
+		}
+		seqmsg hdr(seqno, msgsize);
+		memcpy(frame.data(), &hdr, sizeof(seqmsg));
+		memcpy(frame.data() + sizeof(seqmsg), msgbuf, msgsize);
+		lock_guard<mutex> lock(*wlock);
+		return channel->cwrite(frame.data(), sizeof(seqmsg) + msgsize) - sizeof(seqmsg);
+	}
+};
+
+struct pipeline_state {
+	BoundedBuffer requests; // framed requests waiting for a helper
+	vector<thread> helpers;
+	atomic<int> idle;
+	mutex wlock; // one reply frame on the channel at a time
+
+	pipeline_state () : requests(MAX_PIPELINE), idle(0) {}
+};
+
+void handle_pipelined_requests (RequestChannel* channel, pipeline_state* pipeline) {
+	SeqReplyChannel reply(channel, &pipeline->wlock);
+	char* frame = new char[sizeof(seqmsg) + buffercapacity];
+	// the request is copied out of the frame so that it is aligned and has room for its response
+	vector<char> request(buffercapacity);
+
+	while (true) {
+		pipeline->idle++;
+		int nbytes = pipeline->requests.pop(frame, sizeof(seqmsg) + buffercapacity);
+		pipeline->idle--;
+
+		if (*((MESSAGE_TYPE*) frame) == QUIT_MSG) {
+			// pass the quit message on to the next helper
+			pipeline->requests.push(frame, nbytes);
+			break;
+		}
+		seqmsg hdr(0, 0);
+		memcpy(&hdr, frame, sizeof(seqmsg));
+		memcpy(request.data(), frame + sizeof(seqmsg), min(hdr.length, buffercapacity));
+		if ((int) request.size() < response_size(request.data())) {
+			request.resize(response_size(request.data()));
+		}
+		reply.seqno = hdr.seqno;
+		process_request(&reply, request.data());
+	}
+
+	delete[] frame;
+}
+
+/* Per-channel state of the request loop: the receive buffer, a partial pipelined
+frame carried over from the previous read, and the helper pool once the channel
+has seen a pipelined request. A channel served by the event threads instead counts
+its held replies, and is only closed once the last of them has been sent. */
+struct channel_state {
+	RequestChannel* channel;
+	char* buffer;
+	int capacity;
+	int pending; // bytes of an incomplete pipelined request at the start of buffer
+	pipeline_state* pipeline;
+	bool evented; // registered with epollfd
+	mutex wlock; // one reply on an evented channel at a time
+	int held; // replies of an evented channel waiting for their service time
+	bool closing; // the evented channel is done, but replies are still held
+};
+
+channel_state* open_channel_state (RequestChannel* channel, bool evented) {
 	/* creating a buffer per client to process incoming requests
-	and prepare a response */
-	char* buffer = new char[buffercapacity];
-	if (!buffer) {
+	and prepare a response; pipelined requests may arrive merged or split across
+	reads, so there is room for a partial frame left over from the previous read */
+	channel_state* state = new channel_state;
+	state->channel = channel;
+	state->capacity = 2 * (sizeof(seqmsg) + buffercapacity);
+	state->buffer = new char[state->capacity];
+	if (!state->buffer) {
 		EXITONERROR ("Cannot allocate memory for server buffer");
 	}
+	state->pending = 0;
+	state->pipeline = nullptr;
+	state->evented = evented;
+	state->held = 0;
+	state->closing = false;
+	return state;
+}
+
+void close_channel_state (channel_state* state) {
+	if (state->pipeline) {
+		MESSAGE_TYPE q = QUIT_MSG;
+		state->pipeline->requests.push((char*) &q, sizeof(MESSAGE_TYPE));
+		for (auto& helper : state->pipeline->helpers) {
+			helper.join();
+		}
+		delete state->pipeline;
+	}
+	delete[] state->buffer;
+	delete state->channel;
+	delete state;
+}
+
+/* Keeps what is written to it instead of sending it, so that an event thread can
+serve a request at once and send the reply when its service time is up. */
+class HeldReplyChannel : public RequestChannel {
+public:
+	vector<char> reply;
+
+	HeldReplyChannel (RequestChannel* _channel) : RequestChannel(_channel->name(), SERVER_SIDE) {}
+
+	int cread (void*, int) override {
+		return -1;
+	}
 
-while (true) {
-    int nbytes = channel->cread(buffer, buffercapacity);
-    if (nbytes < 0) {
-        cerr << "Client-side terminated abnormally" << endl;
-        break;
-    } else if (nbytes == 0) {
-        cout << "Server could not read anything... Terminating" << endl;
-        break;
-    }
+	int cwrite (void* msgbuf, int msgsize) override {
+		reply.insert(reply.end(), (char*) msgbuf, (char*) msgbuf + msgsize);
+		return msgsize;
+	}
+};
+
+/* Replies of the event-driven mode waiting for their service time. The event threads
+never sleep: whoever is woken by timerfd sends the replies that are due, and re-arms
+it for the earliest of the rest. */
+struct held_reply {
+	chrono::steady_clock::time_point due;
+	channel_state* state;
+	vector<char> bytes;
+};
+
+struct held_reply_later {
+	bool operator() (const held_reply* a, const held_reply* b) const {
+		return a->due > b->due;
+	}
+};
+
+priority_queue<held_reply*, vector<held_reply*>, held_reply_later> held_replies;
+mutex held_mutex;
+
+// sets timerfd to the earliest held reply, or disarms it; called with held_mutex held
+void arm_held_timer () {
+	struct itimerspec its = {};
+	if (!held_replies.empty()) {
+		auto ns = chrono::duration_cast<chrono::nanoseconds>(held_replies.top()->due.time_since_epoch()).count();
+		its.it_value.tv_sec = ns / 1000000000;
+		its.it_value.tv_nsec = ns % 1000000000;
+	}
+	if (timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &its, nullptr) < 0) {
+		EXITONERROR("timerfd_settime");
+	}
+}
 
-    MESSAGE_TYPE m = *((MESSAGE_TYPE*) buffer);
-    if (m == QUIT_MSG) {
-        cout << "Client-side is done and exited" << endl;
-        break;
-    }
+void hold_reply (channel_state* state, vector<char>& bytes, int delay) {
+	held_reply* r = new held_reply;
+	r->due = chrono::steady_clock::now() + chrono::microseconds(delay);
+	r->state = state;
+	r->bytes.swap(bytes);
+	{
+		lock_guard<mutex> lock(state->wlock);
+		state->held++;
+	}
+	lock_guard<mutex> lock(held_mutex);
+	held_replies.push(r);
+	if (held_replies.top() == r) {
+		arm_held_timer();
+	}
+}
+
+void close_evented_channel (channel_state* state) {
+	close_channel_state(state);
+	lock_guard<mutex> lock(epoll_mutex);
+	if (--nepoll_channels == 0) {
+		epoll_drained.notify_all();
+	}
+}
+
+void send_held_replies () {
+	uint64_t expirations;
+	if (read(timerfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+		EXITONERROR("read timerfd");
+	}
+	vector<held_reply*> due;
+	{
+		lock_guard<mutex> lock(held_mutex);
+		auto now = chrono::steady_clock::now();
+		while (!held_replies.empty() && held_replies.top()->due <= now) {
+			due.push_back(held_replies.top());
+			held_replies.pop();
+		}
+		arm_held_timer();
+	}
+	// let another event thread take the next expiry while these are sent
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = nullptr;
+	epoll_ctl(epollfd, EPOLL_CTL_MOD, timerfd, &ev);
+
+	for (held_reply* r : due) {
+		channel_state* state = r->state;
+		bool done;
+		{
+			lock_guard<mutex> lock(state->wlock);
+			state->channel->cwrite(r->bytes.data(), r->bytes.size());
+			done = --state->held == 0 && state->closing;
+		}
+		delete r;
+		if (done) {
+			close_evented_channel(state);
+		}
+	}
+}
 
-    // Ensure the buffer is interpreted as a datamsg
-    if (m == DATA_MSG) {
-        datamsg* d = (datamsg*) buffer;
+/* Serves one request of an evented channel on the calling event thread, framed with
+seqno if it was pipelined. A reply with a service time is held instead of slept on. */
+void serve_evented (channel_state* state, char* _request, bool framed, int seqno) {
+	int delay = service_delay(_request);
+	HeldReplyChannel held(state->channel);
+	RequestChannel* target = delay > 0 ? (RequestChannel*) &held : state->channel;
+	if (framed) {
+		SeqReplyChannel reply(target, &state->wlock);
+		reply.seqno = seqno;
+		dispatch_request(&reply, _request);
+	}
+	else {
+		dispatch_request(target, _request);
+	}
+	if (delay > 0) {
+		hold_reply(state, held.reply, delay);
+	}
+}
 
-		d->ecgno = 1; // WHY DO I HAVE TO DO THIS
-        cout << "process_request: person=" << d->person << " seconds=" << d->seconds << " ecgno=" << d->ecgno << endl;
+// reads from the channel once and serves what arrived; returns false once the channel is done
+bool serve_channel (channel_state* state) {
+	RequestChannel* channel = state->channel;
+	char* buffer = state->buffer;
 
-        // Debug prints to check the datamsg values before get_data_from_memory
-        cout << "before get_data_from_memory: person=" << d->person << " seconds=" << d->seconds << " ecgno=" << d->ecgno << endl;
+	int nbytes = channel->cread(buffer + state->pending, state->capacity - state->pending);
+	if (nbytes < 0) {
+		cerr << "Client-side terminated abnormally" << endl;
+		return false;
+	}
+	else if (nbytes == 0) {
+		cerr << "Server could not read anything... Terminating" << endl;
+		return false;
+	}
 
-        process_request(channel, buffer);
+	MESSAGE_TYPE m = *((MESSAGE_TYPE*) buffer);
+	if (state->pending == 0 && m != SEQ_MSG) {
+		if (m == QUIT_MSG) {
+			return false;
+		}
+		// a negotiated file chunk can outgrow the buffer the channel started with
+		if (state->capacity < response_size(buffer)) {
+			state->capacity = response_size(buffer);
+			buffer = new char[state->capacity];
+			memcpy(buffer, state->buffer, nbytes);
+			delete[] state->buffer;
+			state->buffer = buffer;
+		}
+		if (state->evented) {
+			serve_evented(state, buffer, false, 0);
+		}
+		else {
+			process_request(channel, buffer);
+		}
+		return true;
+	}
 
-        // Debug prints after get_data_from_memory
-        cout << "after get_data_from_memory: person=" << d->person << " seconds=" << d->seconds << " ecgno=" << d->ecgno << endl;
-    }
-    // ...
+	// hand every complete frame to the helpers, or serve it on an event thread, and keep a trailing partial one
+	int pending = state->pending + nbytes;
+	int pos = 0;
+	while (pending - pos >= (int) sizeof(seqmsg)) {
+		seqmsg hdr(0, 0);
+		memcpy(&hdr, buffer + pos, sizeof(seqmsg));
+		int framelen = sizeof(seqmsg) + hdr.length;
+		if (pending - pos < framelen) {
+			break;
+		}
+		if (state->evented) {
+			// the request is copied out of the frame so that it is aligned and has room for its response
+			vector<char> request(buffercapacity);
+			memcpy(request.data(), buffer + pos + sizeof(seqmsg), min(hdr.length, buffercapacity));
+			if ((int) request.size() < response_size(request.data())) {
+				request.resize(response_size(request.data()));
+			}
+			serve_evented(state, request.data(), true, hdr.seqno);
+			pos += framelen;
+			continue;
+		}
+		if (!state->pipeline) {
+			state->pipeline = new pipeline_state();
+		}
+		pipeline_state* pipeline = state->pipeline;
+		if (pipeline->idle.load() == 0 && pipeline->helpers.size() < MAX_PIPELINE) {
+			pipeline->helpers.push_back(thread(handle_pipelined_requests, channel, pipeline));
+		}
+		pipeline->requests.push(buffer + pos, framelen);
+		pos += framelen;
+	}
+	memmove(buffer, buffer + pos, pending - pos);
+	state->pending = pending - pos;
+	return true;
+}
+
+void handle_process_loop (RequestChannel* channel) {
+	channel_state* state = open_channel_state(channel);
+	while (serve_channel(state));
+	close_channel_state(state);
 }
 
-	delete[] buffer;
-	delete channel;
+void handle_epoll_events () {
+	/* each registered channel is armed with EPOLLONESHOT, so only one pool thread
+	serves it at a time; it is re-armed after every read, even with its reply still
+	held, since a client that does not pipeline sends nothing before the reply.
+	timerfd is registered the same way, with a null data pointer */
+	while (true) {
+		struct epoll_event ev;
+		int n = epoll_wait(epollfd, &ev, 1, -1);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			EXITONERROR("epoll_wait");
+		}
+
+		if (!ev.data.ptr) {
+			send_held_replies();
+			continue;
+		}
+		channel_state* state = (channel_state*) ev.data.ptr;
+		if (serve_channel(state)) {
+			ev.events = EPOLLIN | EPOLLONESHOT;
+			epoll_ctl(epollfd, EPOLL_CTL_MOD, state->channel->poll_fd(), &ev);
+		}
+		else {
+			epoll_ctl(epollfd, EPOLL_CTL_DEL, state->channel->poll_fd(), nullptr);
+			bool idle;
+			{
+				lock_guard<mutex> lock(state->wlock);
+				state->closing = true;
+				idle = state->held == 0;
+			}
+			// otherwise the last held reply closes it
+			if (idle) {
+				close_evented_channel(state);
+			}
+		}
+	}
+}
+
+void stop_daemon (int) {
+	unlink(daemon_fifo.c_str());
+	_exit(0);
+}
+
+/* Daemon mode: the data is loaded once and the server keeps running, serving any number of
+clients, each on its own control channel and data channels. A client attaches by writing an
+attachmsg with the name of its control channel to the well-known FIFO; the daemon serves that
+channel on a new thread, exactly as the control channel of a forked server. The daemon runs
+until it is interrupted or terminated. */
+void serve_daemon () {
+	daemon_fifo = daemon_fifo_name(ipcmethod, buffercapacity);
+	mkfifo(daemon_fifo.c_str(), 0600);
+	// opened for writing too, so that reads block between clients instead of returning EOF
+	int fd = open(daemon_fifo.c_str(), O_RDWR);
+	if (fd < 0) {
+		EXITONERROR(daemon_fifo);
+	}
+	signal(SIGINT, stop_daemon);
+	signal(SIGTERM, stop_daemon);
+	cerr << "Server daemon listening on " << daemon_fifo << endl;
+
+	while (true) {
+		attachmsg a("");
+		int nbytes = read(fd, &a, sizeof(attachmsg));
+		if (nbytes != sizeof(attachmsg) || a.mtype != NEWCHANNEL_MSG) {
+			if (nbytes < 0 && errno != EINTR) {
+				EXITONERROR("read " + daemon_fifo);
+			}
+			continue;
+		}
+		a.name[sizeof(a.name) - 1] = '\0';
+		string name = a.name;
+		thread([name] {
+			RequestChannel* control_channel = create_channel(ipcmethod, name, RequestChannel::SERVER_SIDE, sizeof(seqmsg) + buffercapacity);
+			handle_process_loop(control_channel);
+		}).detach();
+	}
 }
 
 int main (int argc, char* argv[]) {
 	buffercapacity = MAX_MESSAGE;
+	int nevents = -1; // threads serving data channels through epoll, -1 for a thread per channel
+	int ncached = 64; // open files kept by the file cache
+	bool daemon = false; // keep serving clients that attach, instead of one client that forked the server
+	string x = ""; // thread placement, see ThreadPlacement.h
 	int opt;
-	while ((opt = getopt(argc, argv, "m:")) != -1) {
+	while ((opt = getopt(argc, argv, "m:i:e:c:dx:")) != -1) {
 		switch (opt) {
 			case 'm':
 				buffercapacity = atoi(optarg);
 				break;
+			case 'i':
+				ipcmethod = optarg[0];
+				break;
+			case 'e':
+				nevents = atoi(optarg);
+				break;
+			case 'c':
+				ncached = max(atoi(optarg), 0);
+				break;
+			case 'd':
+				daemon = true;
+				break;
+			case 'x':
+				x = optarg;
+				break;
 		}
 	}
+	chunkcapacity = buffercapacity;
+	file_cache = new FileCache(ncached);
+	placement = new ThreadPlacement(x, "ce");
 
 	srand(time_t(NULL));
-	for (int i = 0; i < NUM_PERSONS; i++) {
-		populate_file_data(i+1);
+
+	auto ingest_start = chrono::steady_clock::now();
+	if (map_snapshot()) {
+		double ingest_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - ingest_start).count();
+		cerr << "Server mapped " << SNAPSHOT_FILE << " in " << ingest_ms << " ms" << endl;
+	}
+	else {
+		// parse the data files in parallel, one person at a time per thread
+		int nloaders = min((int) max(thread::hardware_concurrency(), 1u), NUM_PERSONS);
+		vector<thread> loaders;
+		for (int t = 0; t < nloaders; t++) {
+			loaders.push_back(thread([t, nloaders] {
+				for (int i = t; i < NUM_PERSONS; i += nloaders) {
+					populate_file_data(i+1);
+				}
+			}));
+		}
+		for (auto& loader : loaders) {
+			loader.join();
+		}
+		double ingest_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - ingest_start).count();
+		cerr << "Server loaded " << NUM_PERSONS << " data files in " << ingest_ms << " ms using " << nloaders << " threads" << endl;
 	}
 	
-	FIFORequestChannel* control_channel = new FIFORequestChannel("control", FIFORequestChannel::SERVER_SIDE);
+	if (nevents >= 0) {
+		// one event thread per core unless told otherwise
+		if (nevents == 0) {
+			nevents = max(thread::hardware_concurrency(), 1u);
+		}
+		epollfd = epoll_create1(0);
+		if (epollfd < 0) {
+			EXITONERROR("epoll_create1");
+		}
+		timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.ptr = nullptr;
+		if (timerfd < 0 || epoll_ctl(epollfd, EPOLL_CTL_ADD, timerfd, &ev) < 0) {
+			EXITONERROR("timerfd");
+		}
+		for (int i = 0; i < nevents; i++) {
+			thread event_thread(handle_epoll_events);
+			placement->pin_class(event_thread, 'e', i);
+			event_thread.detach();
+		}
+		if (ipcmethod == 's') {
+			cerr << "Shared-memory channels cannot be polled, serving them with a thread each" << endl;
+		}
+	}
+
+	if (daemon) {
+		serve_daemon();
+	}
+
+	RequestChannel* control_channel = create_channel(ipcmethod, "control", RequestChannel::SERVER_SIDE, sizeof(seqmsg) + buffercapacity);
 	handle_process_loop(control_channel);
+
+	if (epollfd >= 0) {
+		// the client quits its data channels before the control channel; give the pool a moment to close them
+		unique_lock<mutex> lock(epoll_mutex);
+		epoll_drained.wait_for(lock, chrono::seconds(1), [] { return nepoll_channels == 0; });
+	}
 	cout << "Server terminated" << endl;
 }
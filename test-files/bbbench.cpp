@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedBuffer.h"
+
+#define PRODUCERS "1,4"
+#define CONSUMERS "1,4"
+#define SIZES "8,256,4096,65536"
+#define CAPS "64"
+#define BATCHES "1,16"
+#define BACKENDS "queue,ring,pool"
+#define OPS 200000
+
+using namespace std;
+
+/* Throughput and latency benchmark for BoundedBuffer.
+
+ Every combination of the comma-separated lists given with the options is run once:
+   -p producers  -c consumers  -s message sizes (bytes, at least 8)  -b capacities
+   -k batch sizes (1 uses push/pop, more use push_n/pop_n)  -q backends (queue, ring, pool)
+   -n messages per run, split across the producers
+ Each message carries the time it was pushed; consumers record how long it spent in the
+ buffer. A run reports messages/s, MB/s and the p50/p99/max of that latency. */
+
+int64_t now_ns () {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+vector<string> split_list (const string& list) {
+    vector<string> items;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+vector<int> int_list (const string& list) {
+    vector<int> values;
+    for (auto& item : split_list(list)) {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+struct run_config {
+    BoundedBuffer::Backend backend;
+    int producers;
+    int consumers;
+    int size;
+    int cap;
+    int batch;
+    int ops;
+};
+
+void producer_function (BoundedBuffer* bb, atomic<bool>* start, int count, int size, int batch) {
+    vector<char> msgs(batch * size, 'x');
+    vector<int> sizes(batch, size);
+    while (!start->load()) {
+        this_thread::yield();
+    }
+    for (int i = 0; i < count; i += batch) {
+        int n = min(batch, count - i);
+        int64_t stamp = now_ns();
+        for (int j = 0; j < n; j++) {
+            memcpy(msgs.data() + j * size, &stamp, sizeof(int64_t));
+        }
+        if (batch > 1) {
+            bb->push_n(msgs.data(), size, sizes.data(), n);
+        }
+        else {
+            bb->push(msgs.data(), size);
+        }
+    }
+}
+
+// pops until it sees a stop message (any message shorter than size) and records the latencies
+void consumer_function (BoundedBuffer* bb, int size, int batch, vector<int64_t>* latencies) {
+    vector<char> msgs(batch * size);
+    vector<int> sizes(batch);
+    while (true) {
+        int n;
+        if (batch > 1) {
+            n = bb->pop_n(msgs.data(), size, sizes.data(), batch);
+        }
+        else {
+            sizes[0] = bb->pop(msgs.data(), size);
+            n = 1;
+        }
+        int64_t now = now_ns();
+        int stops = 0;
+        for (int j = 0; j < n; j++) {
+            if (sizes[j] != size) {
+                stops++;
+                continue;
+            }
+            int64_t stamp;
+            memcpy(&stamp, msgs.data() + j * size, sizeof(int64_t));
+            latencies->push_back(now - stamp);
+        }
+        if (stops > 0) {
+            // stop messages come after all data; keep one and pass the others on
+            char stop = 0;
+            for (int j = 1; j < stops; j++) {
+                bb->push(&stop, 1);
+            }
+            return;
+        }
+    }
+}
+
+void run (const run_config& cfg) {
+    BoundedBuffer bb(cfg.cap, cfg.backend, cfg.size);
+    atomic<bool> start(false);
+    vector<vector<int64_t>> latencies(cfg.consumers);
+    for (auto& l : latencies) {
+        l.reserve(cfg.ops / cfg.consumers + 1);
+    }
+
+    vector<thread> producers;
+    vector<thread> consumers;
+    for (int i = 0; i < cfg.producers; i++) {
+        int count = cfg.ops / cfg.producers + (i < cfg.ops % cfg.producers ? 1 : 0);
+        producers.push_back(thread(producer_function, &bb, &start, count, cfg.size, cfg.batch));
+    }
+    for (int i = 0; i < cfg.consumers; i++) {
+        consumers.push_back(thread(consumer_function, &bb, cfg.size, cfg.batch, &latencies[i]));
+    }
+
+    auto begin = chrono::steady_clock::now();
+    start = true;
+    for (auto& t : producers) {
+        t.join();
+    }
+    char stop = 0;
+    for (int i = 0; i < cfg.consumers; i++) {
+        bb.push(&stop, 1);
+    }
+    for (auto& t : consumers) {
+        t.join();
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    vector<int64_t> all;
+    for (auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    sort(all.begin(), all.end());
+    auto pct = [&all] (double p) {
+        return all.empty() ? 0 : all[min(all.size() - 1, (size_t) (p / 100 * all.size()))];
+    };
+
+    const char* names[] = {"queue", "ring", "pool"};
+    printf("%-7s %5d %5d %7d %6d %5d %12.0f %10.1f %10ld %10ld %10ld\n", names[cfg.backend], cfg.producers, cfg.consumers,
+        cfg.size, cfg.cap, cfg.batch, all.size() / secs, all.size() * (double) cfg.size / 1e6 / secs,
+        (long) pct(50), (long) pct(99), (long) (all.empty() ? 0 : all.back()));
+    fflush(stdout);
+}
+
+int main (int argc, char* argv[]) {
+    string p = PRODUCERS;
+    string c = CONSUMERS;
+    string s = SIZES;
+    string b = CAPS;
+    string k = BATCHES;
+    string q = BACKENDS;
+    int n = OPS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c:s:b:k:q:n:")) != -1) {
+        switch (opt) {
+            case 'p':
+                p = optarg;
+                break;
+            case 'c':
+                c = optarg;
+                break;
+            case 's':
+                s = optarg;
+                break;
+            case 'b':
+                b = optarg;
+                break;
+            case 'k':
+                k = optarg;
+                break;
+            case 'q':
+                q = optarg;
+                break;
+            case 'n':
+                n = max(1, atoi(optarg));
+                break;
+            default:
+                cerr << "usage: " << argv[0] << " [-p producers] [-c consumers] [-s sizes] [-b caps] [-k batches] [-q backends] [-n messages]" << endl;
+                return 1;
+        }
+    }
+
+    printf("%-7s %5s %5s %7s %6s %5s %12s %10s %10s %10s %10s\n", "backend", "prod", "cons", "size", "cap", "batch",
+        "msgs/s", "MB/s", "p50_ns", "p99_ns", "max_ns");
+    for (auto& backend : split_list(q)) {
+        BoundedBuffer::Backend bkend = BoundedBuffer::QUEUE_BACKEND;
+        if (backend == "ring") {
+            bkend = BoundedBuffer::RING_BACKEND;
+        }
+        else if (backend == "pool") {
+            bkend = BoundedBuffer::POOL_BACKEND;
+        }
+        for (int np : int_list(p)) {
+            for (int nc : int_list(c)) {
+                for (int size : int_list(s)) {
+                    for (int cap : int_list(b)) {
+                        for (int batch : int_list(k)) {
+                            run({bkend, max(np, 1), max(nc, 1), max(size, (int) sizeof(int64_t)), max(cap, 1), max(batch, 1), n});
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
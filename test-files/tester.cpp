@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
 
 #include <iostream>
 #include <mutex>
@@ -13,6 +14,8 @@
 #define NUM 1
 #define MIN_SLEEP 0
 #define MAX_SLEEP 1
+#define BACKEND 0
+#define BATCH 1
 
 using namespace std;
 
@@ -55,7 +58,27 @@ void remove_word (vector<char*>* words, char* wrd, int size) {
 }
 
 // thread to push count char buffers to BoundedBuffer
-void push_thread_function (int count, int min, int max, int size, vector<char*>* words, BoundedBuffer* bb) {
+void push_thread_function (int count, int min, int max, int size, int batch, vector<char*>* words, BoundedBuffer* bb) {
+    if (batch > 1) {
+        // push in batches of up to batch words with push_n
+        vector<char> wrds(batch * size);
+        vector<int> sizes(batch, size);
+        for (int i = 0; i < count; i += batch) {
+            int n = (count - i < batch) ? count - i : batch;
+            for (int j = 0; j < n; j++) {
+                char* wrd = new char[size];
+                make_word(wrd, size);
+                add_word(words, wrd);
+                memcpy(wrds.data() + j * size, wrd, size);
+            }
+
+            sleep((rand() % ((max+1)-min)) + min);
+
+            bb->push_n(wrds.data(), size, sizes.data(), n);
+        }
+        return;
+    }
+
     for (int i = 0; i < count; i++) {
         char* wrd = new char[size];
         make_word(wrd, size);
@@ -68,7 +91,26 @@ void push_thread_function (int count, int min, int max, int size, vector<char*>*
 }
 
 // thread to pop count char buffers from BoundedBuffer
-void pop_thread_function (int count, int min, int max, int size, BoundedBuffer* bb, vector<char*>* words) {
+void pop_thread_function (int count, int min, int max, int size, int batch, BoundedBuffer* bb, vector<char*>* words) {
+    if (batch > 1) {
+        // pop_n may return fewer than asked for, so keep going until count words are popped
+        vector<char> wrds(batch * size);
+        vector<int> sizes(batch);
+        int i = 0;
+        while (i < count) {
+            sleep((rand() % ((max+1)-min)) + min);
+
+            int n = bb->pop_n(wrds.data(), size, sizes.data(), (count - i < batch) ? count - i : batch);
+            for (int j = 0; j < n; j++) {
+                if (sizes[j] == size) {
+                    remove_word(words, wrds.data() + j * size, size);
+                }
+            }
+            i += n;
+        }
+        return;
+    }
+
     for (int i = 0; i < count; i++) {
         sleep((rand() % ((max+1)-min)) + min);
 
@@ -89,6 +131,8 @@ int main () {
     int nthrd = NUM;
     int lower = MIN_SLEEP;
     int upper = MAX_SLEEP;
+    int bkend = BACKEND;
+    int batch = BATCH;
 
     // change BoundedBuffer capacity, word size, number of threads, and sleep range
     char opt;
@@ -114,6 +158,12 @@ int main () {
             case 'u':
                 upper = val;
                 break;
+            case 'q':
+                bkend = val;
+                break;
+            case 'k':
+                batch = val;
+                break;
             default:
                 cerr << "Invalid option - " << opt << endl;
                 break;
@@ -135,12 +185,18 @@ int main () {
     if (upper <= lower) {
         upper = lower+1;
     }
-    cerr << "bbcap: " << bbcap << ", wsize: " << wsize << ", nthrd: " << nthrd << ", lower: " << lower << ", upper: " << upper << endl;
+    if (batch < 1) {
+        batch = BATCH;
+    }
+    if (bkend < BoundedBuffer::QUEUE_BACKEND || bkend > BoundedBuffer::POOL_BACKEND) {
+        bkend = BACKEND;
+    }
+    cerr << "bbcap: " << bbcap << ", wsize: " << wsize << ", nthrd: " << nthrd << ", lower: " << lower << ", upper: " << upper << ", backend: " << bkend << ", batch: " << batch << endl;
 
     // initialize overhead
     srand(time(nullptr));
 
-    BoundedBuffer bb(bbcap);
+    BoundedBuffer bb(bbcap, (BoundedBuffer::Backend) bkend, wsize);
 
     thread** push_thrds = new thread*[nthrd];
     thread** pop_thrds = new thread*[nthrd];
@@ -165,7 +221,7 @@ int main () {
 
         if (type == "push") {
             if (idx_push < nthrd) {
-                push_thrds[idx_push++] = new thread(push_thread_function, reqs, lower, upper, wsize, &words, &bb);
+                push_thrds[idx_push++] = new thread(push_thread_function, reqs, lower, upper, wsize, batch, &words, &bb);
                 count += reqs;
                 if (count > bbcap) {
                     cerr << "Push thread should block" << endl;
@@ -177,7 +233,7 @@ int main () {
         }
         else if (type == "pop") {
             if (idx_pop < nthrd) {
-                pop_thrds[idx_pop++] = new thread(pop_thread_function, reqs, lower, upper, wsize, &bb, &words);
+                pop_thrds[idx_pop++] = new thread(pop_thread_function, reqs, lower, upper, wsize, batch, &bb, &words);
                 count -= reqs;
                 if (count < 0) {
                     cerr << "Pop thread should block" << endl;